@@ -14,6 +14,13 @@ Min(float A, float B)
     return(Result);
 }
 
+inline float
+Abs(float A)
+{
+    float Result = A < 0 ? -A : A;
+    return(Result);
+}
+
 union v2
 {
     struct {
@@ -66,6 +73,16 @@ operator*(v2 A, float Value)
     return(Result);
 }
 
+inline v2
+operator-(v2 A, v2 B)
+{
+    v2 Result = {
+        A.X - B.X,
+        A.Y - B.Y
+    };
+    return(Result);
+}
+
 union rec
 {
     struct
@@ -98,6 +115,33 @@ Overlap(rec A, rec B)
     return(Result);
 }
 
+// NOTE: Plain interval test, edges touching count.  Overlap above only
+// looks for a corner of A inside B, which misses a long thin A crossing B.
+inline bool
+Intersects(rec A, rec B)
+{
+    bool Result = (A.Left <= B.Right && B.Left <= A.Right &&
+                   A.Top <= B.Bottom && B.Top <= A.Bottom);
+    return(Result);
+}
+
+// NOTE: A and A moved by Sweep, and everything between.
+inline rec
+SweepBounds(rec A, v2 Sweep)
+{
+    rec Result = {
+        Min(A.Left, A.Left + Sweep.X),
+        Min(A.Top, A.Top + Sweep.Y),
+        Max(A.Right, A.Right + Sweep.X),
+        Max(A.Bottom, A.Bottom + Sweep.Y)
+    };
+    return(Result);
+}
+
+#include "app_rewind.cpp"
+#include "app_particles.cpp"
+#include "app_render.cpp"
+
 enum entity_state_type
 {
     EntityState_Dead,
@@ -119,17 +163,20 @@ struct entity
 #define IsDead(State) (State == EntityState_Dead)
 
 inline rec
-EntityBounds(entity E)
+EntityBounds(entity E, v2 Offset = {})
 {
     rec Result = {
-        E.P.X,
-        E.P.Y,
-        E.P.X + E.Dim.Width,
-        E.P.Y + E.Dim.Height
+        Offset.X + E.P.X,
+        Offset.Y + E.P.Y,
+        Offset.X + E.P.X + E.Dim.Width,
+        Offset.Y + E.P.Y + E.Dim.Height
     };
     return(Result);
 }
 
+// NOTE: (Marcus) Invader positions are relative to their fleet, moving a
+// fleet is one add no matter how many invaders are in it.  Invaders are
+// found by index rather than pointer so game_state can be copied anywhere.
 struct invader_fleet
 {
     u32 ID;
@@ -138,9 +185,33 @@ struct invader_fleet
     v2 Dim;
     u32 DeadInvaders;
     u32 InvaderCount;
-    entity *Invaders;
+    u32 FirstInvader;
 };
 
+inline rec
+FleetBounds(invader_fleet *Fleet)
+{
+    rec Result = {
+        Fleet->P.X,
+        Fleet->P.Y,
+        Fleet->P.X + Fleet->Dim.Width,
+        Fleet->P.Y + Fleet->Dim.Height
+    };
+    return(Result);
+}
+
+// NOTE: Fleets still waiting above the screen or already wiped out cost
+// nothing past moving their origin.
+inline bool
+FleetIsActive(app_input Input, invader_fleet *Fleet)
+{
+    bool Alive = Fleet->DeadInvaders < Fleet->InvaderCount;
+    bool OnScreen = ((Fleet->P.Y + Fleet->Dim.Height) > 0 &&
+                     Fleet->P.Y < Input.ScreenHeight);
+    bool Result = Alive && OnScreen;
+    return(Result);
+}
+
 enum level_outcome_type
 {
     LevelOutcome_Unknown,
@@ -149,20 +220,52 @@ enum level_outcome_type
 };
 
 #define NUM_LEVELS 1
-#define MAX_INVADERS 20
+#define MAX_FLEETS 8
+#define MAX_INVADERS_PER_FLEET 20
+#define MAX_INVADERS (MAX_FLEETS*MAX_INVADERS_PER_FLEET)
 #define MAX_MISSLES 10
 struct game_state
 {
     bool Initialized;
 
-    entity Player;
+    u32 PlayerCount;
+    entity Players[MAX_PLAYERS];
     entity PlayerMissiles[MAX_MISSLES];
 
-    invader_fleet Fleet;
+    u32 FleetCount;
+    invader_fleet Fleets[MAX_FLEETS];
     entity Invaders[MAX_INVADERS];
     entity InvaderMissiles[MAX_MISSLES];
 
     level_outcome_type LevelOutcome;
+
+    // NOTE: How long missile collision has gone unchecked, see UpdateGame.
+    float CollisionSkippedSecs;
+};
+
+// NOTE: (Marcus) Invaders only ever move with their fleet, so each fleet
+// is drawn once into its own layer and the layer is blitted every frame.
+// The layer is redrawn only when an invader in it dies.
+struct fleet_layer
+{
+    bool IsValid;
+    u32 DeadInvaders;
+
+    u32 Width;
+    u32 Height;
+    umi Capacity;
+    u32 *Pixels;
+};
+
+// NOTE: (Marcus) Anything in here can be thrown away and rebuilt, it is
+// not part of the game_state that rewind snapshots.
+struct transient_state
+{
+    bool Initialized;
+    memory_arena Arena;
+    rewind_buffer Rewind;
+    particle_pool Particles;
+    fleet_layer FleetLayers[MAX_FLEETS];
 };
 
 inline bool
@@ -172,33 +275,104 @@ KeyIsDown(app_input *Input, u32 KeyCode)
     return(Result);
 }
 
-inline bool
-KeyPressed(app_input *Input, u32 KeyCode)
+struct key_held_interval
+{
+    float Start;
+    float End;
+    u64 StartTimestamp;
+};
+
+// NOTE: (Marcus) Splits the frame into the stretches a key was held.  Input
+// with no events for the key (batch simulation, network play) counts as
+// held for the whole frame or not at all.
+internal u32
+GetKeyHeldIntervals(app_input *Input, u32 KeyCode, key_held_interval *Intervals, u32 MaxIntervals)
+{
+    u32 Count = 0;
+    float FrameSecs = Input->FrameEllapsedSecs;
+
+    bool HasEvents = false;
+    for (u32 Index = 0; Index < Input->EventCount; ++Index)
+    {
+        HasEvents |= (Input->Events[Index].KeyCode == KeyCode);
+    }
+
+    bool IsDown = HasEvents
+        ? Input->OldKeyState[KeyCode].IsDown
+        : Input->KeyState[KeyCode].IsDown;
+    key_held_interval Current = {};
+    for (u32 Index = 0; Index < Input->EventCount; ++Index)
+    {
+        app_input_event *Event = &Input->Events[Index];
+        if (Event->KeyCode != KeyCode || Event->IsDown == IsDown) continue;
+
+        float Time = Max(Min(Event->TimeSecs, FrameSecs), 0);
+        if (Event->IsDown)
+        {
+            Current.Start = Time;
+            Current.StartTimestamp = Event->Timestamp;
+        }
+        else if (Count < MaxIntervals)
+        {
+            Current.End = Time;
+            Intervals[Count++] = Current;
+        }
+        IsDown = Event->IsDown;
+    }
+
+    if (IsDown && Count < MaxIntervals)
+    {
+        Current.End = FrameSecs;
+        Intervals[Count++] = Current;
+    }
+
+    return(Count);
+}
+
+// NOTE: (Marcus) Local play reads the keyboard, networked play only has
+// which buttons were held for the tick.
+internal u32
+GetButtonHeldIntervals(app_input *Input, u32 PlayerIndex, app_button Button,
+                       key_held_interval *Intervals, u32 MaxIntervals)
 {
-    bool IsDown = Input->KeyState[KeyCode].IsDown;
-    bool WasDown = Input->OldKeyState[KeyCode].IsDown;
-    bool Result = (IsDown || (IsDown && WasDown));
+    u32 Result = 0;
+    if (Input->PlayerCount == 0)
+    {
+        u32 KeyCode = (Button == Button_Left) ? (u32)'A' : (Button == Button_Right) ? (u32)'D' : 0x20;
+        Result = GetKeyHeldIntervals(Input, KeyCode, Intervals, MaxIntervals);
+    }
+    else if ((Input->PlayerButtons[PlayerIndex] & Button) && MaxIntervals)
+    {
+        Intervals[0] = {0, Input->FrameEllapsedSecs, 0};
+        Result = 1;
+    }
     return(Result);
 }
 
-internal void
-InitializeLevel(app_input Input, game_state *GameState)
+inline float
+ButtonHeldSecs(app_input *Input, u32 PlayerIndex, app_button Button)
 {
-    char InvaderLayout[] = R"(
-        0X0X0X0X0X|
-        X0XX00XX0X|
-        XX0X00X0XX|
-        00X0000X00
-    )";
+    key_held_interval Intervals[MAX_INPUT_EVENTS];
+    u32 Count = GetButtonHeldIntervals(Input, PlayerIndex, Button, Intervals, ArraySize(Intervals));
 
+    float Result = 0;
+    for (u32 Index = 0; Index < Count; ++Index)
+    {
+        Result += Intervals[Index].End - Intervals[Index].Start;
+    }
+    return(Result);
+}
+
+internal void
+InitializeFleet(game_state *GameState, invader_fleet *Fleet, const char *InvaderLayout, u32 LayoutSize)
+{
     u32 Count = 0;
-    float StartX = 5;
-    float StartY = 5;
     float PaddingX = 10;
     float PaddingY = 20;
-    float OffsetX = StartX;
-    float OffsetY = StartY;
-    for (u32 C = 0; C < ArraySize(InvaderLayout); ++C)
+    float OffsetX = 0;
+    float OffsetY = 0;
+    entity *Invaders = GameState->Invaders + Fleet->FirstInvader;
+    for (u32 C = 0; C < LayoutSize; ++C)
     {
         char I = InvaderLayout[C];
         switch(I)
@@ -208,8 +382,9 @@ InitializeLevel(app_input Input, game_state *GameState)
             break;
 
             case 'X': {
+                Assert(Count < MAX_INVADERS_PER_FLEET);
                 OffsetX += InvaderDim + PaddingX;
-                entity *Invader = &GameState->Invaders[Count];
+                entity *Invader = &Invaders[Count];
                 Invader->P = {OffsetX, OffsetY};
                 Invader->Dim = {InvaderDim,InvaderDim};
                 Invader->FireRateSecs = 0.5;
@@ -218,7 +393,7 @@ InitializeLevel(app_input Input, game_state *GameState)
             } break;
 
             case '|':
-                OffsetX = StartX;
+                OffsetX = 0;
                 OffsetY += InvaderDim + PaddingY;
             break;
         }
@@ -227,15 +402,59 @@ InitializeLevel(app_input Input, game_state *GameState)
     OffsetX += InvaderDim;
     OffsetY += InvaderDim + PaddingY;
 
-    GameState->Fleet.P = {StartX,StartY};
-    GameState->Fleet.dP = {200.0f, 10.0f};
-    GameState->Fleet.Dim = {OffsetX-StartX,OffsetY-StartY};
-    GameState->Fleet.Invaders = GameState->Invaders;
-    GameState->Fleet.InvaderCount = Count;
+    Fleet->Dim = {OffsetX,OffsetY};
+    Fleet->InvaderCount = Count;
 }
 
 internal void
-AddMissile(game_state *GameState, entity Player)
+InitializeLevel(app_input Input, game_state *GameState)
+{
+    const char *InvaderLayouts[] = {
+        R"(
+        0X0X0X0X0X|
+        X0XX00XX0X|
+        XX0X00X0XX|
+        00X0000X00
+        )",
+        R"(
+        XX00XX00XX|
+        0XX0XX0XX0|
+        00XXXXXX00
+        )",
+        R"(
+        X0X0X0X0X0|
+        0X0X0X0X0X|
+        X0X0X0X0X0|
+        0X0X0X0X0X
+        )"
+    };
+
+    // NOTE: (Marcus) The first wave starts on screen, the rest queue up
+    // above it in their own formation and speed.
+    float StartX = 5;
+    float StartY = 5;
+    float WaveGapY = 60;
+    GameState->FleetCount = MAX_FLEETS;
+    for (u32 FleetIndex = 0; FleetIndex < GameState->FleetCount; ++FleetIndex)
+    {
+        invader_fleet *Fleet = &GameState->Fleets[FleetIndex];
+        Fleet->ID = FleetIndex;
+        Fleet->FirstInvader = FleetIndex * MAX_INVADERS_PER_FLEET;
+
+        const char *Layout = InvaderLayouts[FleetIndex % ArraySize(InvaderLayouts)];
+        InitializeFleet(GameState, Fleet, Layout, (u32)strlen(Layout));
+
+        float Direction = (FleetIndex & 1) ? -1.0f : 1.0f;
+        Fleet->P = {StartX, StartY};
+        Fleet->dP = {Direction * (200.0f + 25.0f*FleetIndex), 10.0f + 2.0f*FleetIndex};
+        StartY -= Fleet->Dim.Height + WaveGapY;
+    }
+}
+
+// NOTE: (Marcus) A missile fired part way into the frame starts behind
+// the player by the time it will not get to fly this frame.
+internal void
+AddMissile(game_state *GameState, entity Player, float FiredAtSecs)
 {
     for (u32 Index = 0;
          Index < ArraySize(GameState->PlayerMissiles);
@@ -244,8 +463,8 @@ AddMissile(game_state *GameState, entity Player)
         entity *FreeMissle = &GameState->PlayerMissiles[Index];
         if (FreeMissle->State == EntityState_Dead)
         {
-            FreeMissle->P = Player.P;
             FreeMissle->dP = {0,-500};
+            FreeMissle->P = Player.P - (FiredAtSecs * FreeMissle->dP);
             FreeMissle->Dim = {5,10};
             FreeMissle->State = EntityState_Alive;
             break;
@@ -274,39 +493,55 @@ AdvancePositions(app_input Input, entity *Entities, u32 Count)
     }
 }
 
+// NOTE: (Marcus) Later waves descend faster and catch up with the ones
+// below.  Fleet layers are opaque, so a wave that catches up is held
+// FLEET_MIN_GAP above the nearest fleet below it that still has invaders,
+// and carries on at its own speed once that fleet is wiped out.
+#define FLEET_MIN_GAP 10.0f
+
 internal void
-AdvanceInvaderFleet(app_input Input, invader_fleet *Fleet)
+AdvanceInvaderFleets(app_input Input, invader_fleet *Fleets, u32 FleetCount)
 {
-    v2 P = Fleet->P;
-    v2 dP = Fleet->dP;
-    v2 Dim = Fleet->Dim;
-    P = P + (dP * Input.FrameEllapsedSecs);
+    invader_fleet *Below = 0;
+    for (u32 Index = 0; Index < FleetCount; ++Index)
+    {
+        invader_fleet *Fleet = &Fleets[Index];
+        v2 P = Fleet->P;
+        v2 dP = Fleet->dP;
+        v2 Dim = Fleet->Dim;
+        P = P + (dP * Input.FrameEllapsedSecs);
 
-    if ((P.X + Dim.Width) >= Input.ScreenWidth)
-        dP.X *= -1;
-    if (P.X <= 0)
-        dP.X *= -1;
-    
-    Fleet->P = P;
-    Fleet->dP = dP;
+        if ((P.X + Dim.Width) >= Input.ScreenWidth)
+            dP.X = -Abs(dP.X);
+        if (P.X <= 0)
+            dP.X = Abs(dP.X);
 
-    for (u32 I = 0; I < Fleet->InvaderCount; ++I)
-    {
-        entity *Invader = &Fleet->Invaders[I];
-        v2 IdP = (dP * Input.FrameEllapsedSecs);
-        Invader->P = Invader->P + IdP;
-        Invader->dP = dP;
+        if (Below)
+        {
+            P.Y = Min(P.Y, Below->P.Y - Dim.Height - FLEET_MIN_GAP);
+        }
+
+        Fleet->P = P;
+        Fleet->dP = dP;
+        if (Fleet->DeadInvaders < Fleet->InvaderCount)
+        {
+            Below = Fleet;
+        }
     }
 }
 
+#define MAX_COLLISION_POINTS 16
 struct CollisionResult
 {
+    u32 PairsTested;
     u32 CollisionCount;
+    v2 Points[MAX_COLLISION_POINTS];
 };
 
 internal CollisionResult
 DetectCollisions(entity *GroupA, u32 GroupACount, 
-                 entity *GroupB, u32 GroupBCount)
+                 entity *GroupB, u32 GroupBCount,
+                 v2 GroupBOffset = {})
 {
     CollisionResult Result = {};
 
@@ -320,12 +555,17 @@ DetectCollisions(entity *GroupA, u32 GroupACount,
             entity *EntB = &GroupB[B];
             if (IsDead(EntB->State)) continue;
 
+            ++Result.PairsTested;
             rec EntADim = EntityBounds(*EntA);
-            rec EntBDim = EntityBounds(*EntB);
+            rec EntBDim = EntityBounds(*EntB, GroupBOffset);
             if (Overlap(EntADim, EntBDim))
             {
                 EntA->State = EntityState_Dead;
                 EntB->State = EntityState_Dead;
+                if (Result.CollisionCount < MAX_COLLISION_POINTS)
+                {
+                    Result.Points[Result.CollisionCount] = GroupBOffset + EntB->P + (0.5f * EntB->Dim);
+                }
                 ++Result.CollisionCount;
             }
         }
@@ -334,76 +574,363 @@ DetectCollisions(entity *GroupA, u32 GroupACount,
     return(Result);
 }
 
-internal void
-GameUpdateAndRender(app_input Input, app_memory *Memory, render_commands *RenderCommands)
+// NOTE: (Marcus) Missile against invaders over the path it took since
+// Sweep ago, for when collision was skipped.  Only the first invader along
+// the path is hit, the one furthest back towards where the missile was.
+internal CollisionResult
+DetectSweptCollision(entity *Missile, v2 Sweep, entity *Invaders, u32 InvaderCount, v2 Offset)
 {
-    game_state *GameState = (game_state *)Memory->PerminantStorage;
-    if (!GameState->Initialized)
+    CollisionResult Result = {};
+    rec MissileBounds = SweepBounds(EntityBounds(*Missile), Sweep);
+
+    entity *First = 0;
+    float FirstAlong = 0;
+    for (u32 Index = 0; Index < InvaderCount; ++Index)
     {
-        GameState->Initialized = true;
-        GameState->Player.FireRateSecs = 0.2f;
-        GameState->Player.P = {(float)Input.ScreenWidth/2.0f, (float)Input.ScreenHeight-100.0f};
-        GameState->Player.Dim = {PlayerDim, PlayerDim};
+        entity *Invader = &Invaders[Index];
+        if (IsDead(Invader->State)) continue;
 
-        InitializeLevel(Input, GameState);
+        ++Result.PairsTested;
+        if (Intersects(MissileBounds, EntityBounds(*Invader, Offset)))
+        {
+            v2 Center = Offset + Invader->P + (0.5f * Invader->Dim);
+            float Along = (Center.X * Sweep.X) + (Center.Y * Sweep.Y);
+            if (!First || Along > FirstAlong)
+            {
+                First = Invader;
+                FirstAlong = Along;
+            }
+        }
     }
 
-    float PlayerSpeed = 500 * Input.FrameEllapsedSecs;
-    if (KeyIsDown(&Input, (u32)'A'))
+    if (First)
     {
-        GameState->Player.P.X -= PlayerSpeed;
+        Missile->State = EntityState_Dead;
+        First->State = EntityState_Dead;
+        Result.Points[0] = Offset + First->P + (0.5f * First->Dim);
+        Result.CollisionCount = 1;
     }
-    if (KeyIsDown(&Input, (u32)'D'))
+    return(Result);
+}
+
+inline u32
+CountLiveEntities(entity *Entities, u32 Count)
+{
+    u32 Result = 0;
+    for (u32 Index = 0; Index < Count; ++Index)
     {
-        GameState->Player.P.X += PlayerSpeed;
+        Result += !IsDead(Entities[Index].State);
     }
-    
-    float FireRate = GameState->Player.FireRateSecs;
-    float FireDelay = Max(GameState->Player.FireDelaySecs - Input.FrameEllapsedSecs, 0);
-    GameState->Player.FireDelaySecs = FireDelay;
-    if (KeyIsDown(&Input, 0x20) && FireDelay <= 0)
+    return(Result);
+}
+
+inline float
+ScreenPan(app_input Input, float X)
+{
+    float Result = ((2.0f * X) / (float)Input.ScreenWidth) - 1.0f;
+    Result = Max(Min(Result, 1.0f), -1.0f);
+    return(Result);
+}
+
+internal void
+UpdateGame(app_input Input, game_state *GameState, audio_commands *AudioCommands,
+           particle_pool *Particles, app_frame_stats *Stats)
+{
+    // NOTE: (Marcus) Movement and firing follow the key events inside the
+    // frame instead of the key state at the end of it.
+    float PlayerSpeed = 500;
+    float FrameSecs = Input.FrameEllapsedSecs;
+    Stats->FireEventTimestamp = 0;
+    for (u32 PlayerIndex = 0; PlayerIndex < GameState->PlayerCount; ++PlayerIndex)
     {
-        GameState->Player.FireDelaySecs = FireRate;
-        AddMissile(GameState, GameState->Player);
+        entity *Player = &GameState->Players[PlayerIndex];
+        float HeldLeft = ButtonHeldSecs(&Input, PlayerIndex, Button_Left);
+        float HeldRight = ButtonHeldSecs(&Input, PlayerIndex, Button_Right);
+        Player->P.X += PlayerSpeed * (HeldRight - HeldLeft);
+
+        // NOTE: ReadyAt is when the gun can fire next, counted from the
+        // start of this frame.
+        float ReadyAt = Player->FireDelaySecs;
+        key_held_interval FireHeld[MAX_INPUT_EVENTS];
+        u32 FireHeldCount = GetButtonHeldIntervals(&Input, PlayerIndex, Button_Fire,
+                                                   FireHeld, ArraySize(FireHeld));
+        for (u32 Index = 0; Index < FireHeldCount; ++Index)
+        {
+            key_held_interval *Held = &FireHeld[Index];
+            for (float FireAt = Max(Held->Start, ReadyAt);
+                 FireAt <= Held->End && FireAt < FrameSecs;
+                 FireAt = ReadyAt)
+            {
+                AddMissile(GameState, *Player, FireAt);
+                PushSound(AudioCommands, Sound_Laser, 0.4f, ScreenPan(Input, Player->P.X));
+                if (FireAt == Held->Start && Held->StartTimestamp)
+                {
+                    Stats->FireEventTimestamp = Held->StartTimestamp;
+                }
+                ReadyAt = FireAt + Player->FireRateSecs;
+            }
+        }
+        Player->FireDelaySecs = Max(ReadyAt - FrameSecs, 0);
     }
 
-    AdvanceInvaderFleet(Input, &GameState->Fleet);
+    AdvanceInvaderFleets(Input, GameState->Fleets, GameState->FleetCount);
 
     AdvancePositions(Input, GameState->PlayerMissiles, ArraySize(GameState->PlayerMissiles));
 
     CollisionResult Fails = DetectCollisions(
-        {&GameState->Player}, 1,
+        GameState->Players, GameState->PlayerCount,
         GameState->InvaderMissiles, ArraySize(GameState->InvaderMissiles));
+    app_counters *Counters = &Stats->Counters;
+    Counters->CollisionPairsTested += Fails.PairsTested;
+    Counters->CollisionPairsHit += Fails.CollisionCount;
+
+    // NOTE: (Marcus) Under load the platform can have missile collision
+    // run every other frame.  Frames run long exactly when that happens, so
+    // a missile can move further than an invader is tall between checks.
+    // The next check sweeps each missile back over the frames it missed.
+    // Fleets moved a little meanwhile too, that is not swept.
+    bool SkipCollision = Input.Quality.SkipCollision;
+    float SweepSecs = GameState->CollisionSkippedSecs;
+    GameState->CollisionSkippedSecs = SkipCollision ? (SweepSecs + FrameSecs) : 0;
+
+    u64 CollisionStart = __rdtsc();
+    u32 FleetsCleared = 0;
+    for (u32 FleetIndex = 0; FleetIndex < GameState->FleetCount; ++FleetIndex)
+    {
+        invader_fleet *Fleet = &GameState->Fleets[FleetIndex];
+        if (!FleetIsActive(Input, Fleet))
+        {
+            FleetsCleared += (Fleet->DeadInvaders >= Fleet->InvaderCount);
+            continue;
+        }
+        if (SkipCollision) continue;
 
-    CollisionResult Hits = DetectCollisions(
-        GameState->PlayerMissiles, ArraySize(GameState->PlayerMissiles),
-        GameState->Invaders, ArraySize(GameState->Invaders));
-    GameState->Fleet.DeadInvaders += Hits.CollisionCount;
+        // NOTE: (Marcus) Only missiles inside the fleet bounds get tested
+        // against its invaders.
+        entity *Invaders = GameState->Invaders + Fleet->FirstInvader;
+        rec Bounds = FleetBounds(Fleet);
+        for (u32 Index = 0; Index < ArraySize(GameState->PlayerMissiles); ++Index)
+        {
+            entity *Missile = &GameState->PlayerMissiles[Index];
+            v2 Sweep = (-SweepSecs) * Missile->dP;
+            if (IsDead(Missile->State) ||
+                !Intersects(SweepBounds(EntityBounds(*Missile), Sweep), Bounds)) continue;
+
+            CollisionResult Hits = SweepSecs
+                ? DetectSweptCollision(Missile, Sweep, Invaders, Fleet->InvaderCount, Fleet->P)
+                : DetectCollisions(Missile, 1, Invaders, Fleet->InvaderCount, Fleet->P);
+            Fleet->DeadInvaders += Hits.CollisionCount;
+            Counters->CollisionPairsTested += Hits.PairsTested;
+            Counters->CollisionPairsHit += Hits.CollisionCount;
+            if (Hits.CollisionCount)
+            {
+                v2 HitP = Hits.Points[0];
+                PushSound(AudioCommands, Sound_Explosion, 0.8f, ScreenPan(Input, HitP.X));
+                SpawnParticleBurst(Particles, HitP, 4096, RGB_U32(40, 90, 160), 350.0f);
+                SpawnParticleBurst(Particles, HitP, 1024, RGB_U32(160, 60, 20), 150.0f);
+            }
+        }
+    }
+    if (!SkipCollision)
+    {
+        Stats->CollisionCycles = __rdtsc() - CollisionStart;
+    }
 
+    level_outcome_type Outcome = FleetsCleared >= GameState->FleetCount
+        ? LevelOutcome_YouWin
+        : LevelOutcome_Unknown;
+    Outcome = Fails.CollisionCount > 0
+        ? LevelOutcome_YouLose
+        : Outcome;
+    GameState->LevelOutcome = Outcome;
+}
+
+internal void
+RasterizeFleetLayer(game_state *GameState, invader_fleet *Fleet, fleet_layer *Layer,
+                    memory_arena *Arena)
+{
+    Layer->Width = (u32)Fleet->Dim.Width;
+    Layer->Height = (u32)Fleet->Dim.Height;
+
+    // NOTE: A fleet only changes size when a new level starts, so the
+    // occasional bigger layer is just pushed again.
+    umi PixelCount = Layer->Width * Layer->Height;
+    if (PixelCount > Layer->Capacity)
+    {
+        Layer->Pixels = PushArray(Arena, PixelCount, u32);
+        Layer->Capacity = PixelCount;
+    }
+    memset(Layer->Pixels, 0, PixelCount * sizeof(u32));
+
+    u32 Color = RGB_U32(0, 150, 255);
+    entity *Invaders = GameState->Invaders + Fleet->FirstInvader;
+    for (u32 Index = 0; Index < Fleet->InvaderCount; ++Index)
+    {
+        entity *Invader = &Invaders[Index];
+        if (IsDead(Invader->State)) continue;
+
+        u32 MinX = (u32)Invader->P.X;
+        u32 MinY = (u32)Invader->P.Y;
+        u32 MaxX = (u32)(Invader->P.X + Invader->Dim.Width);
+        u32 MaxY = (u32)(Invader->P.Y + Invader->Dim.Height);
+        MaxX = (MaxX > Layer->Width) ? Layer->Width : MaxX;
+        MaxY = (MaxY > Layer->Height) ? Layer->Height : MaxY;
+        for (u32 Y = MinY; Y < MaxY; ++Y)
+        {
+            u32 *Row = Layer->Pixels + Y*Layer->Width;
+            for (u32 X = MinX; X < MaxX; ++X)
+            {
+                Row[X] = Color;
+            }
+        }
+    }
+
+    Layer->DeadInvaders = Fleet->DeadInvaders;
+    Layer->IsValid = true;
+}
+
+internal void
+InitializeGame(app_input Input, game_state *GameState)
+{
+    GameState->Initialized = true;
+
+    // NOTE: Players are spread evenly along the bottom.
+    GameState->PlayerCount = Input.PlayerCount ? Input.PlayerCount : 1;
+    for (u32 PlayerIndex = 0; PlayerIndex < GameState->PlayerCount; ++PlayerIndex)
+    {
+        entity *Player = &GameState->Players[PlayerIndex];
+        float Spacing = (float)Input.ScreenWidth / (float)(GameState->PlayerCount + 1);
+        Player->FireRateSecs = 0.2f;
+        Player->P = {Spacing * (float)(PlayerIndex + 1), (float)Input.ScreenHeight-100.0f};
+        Player->Dim = {PlayerDim, PlayerDim};
+    }
+
+    InitializeLevel(Input, GameState);
+}
+
+internal void
+GameUpdateAndRender(app_input Input, app_memory *Memory, render_commands *RenderCommands,
+                    audio_commands *AudioCommands)
+{
+    Memory->PerminantStorageCommitted = CommitToFit(
+        Memory->PerminantStorage, Memory->PerminantStorageSize,
+        Memory->PerminantStorageCommitted, sizeof(game_state), Memory->CommitMemory);
+    Memory->TransientStorageCommitted = CommitToFit(
+        Memory->TransientStorage, Memory->TransientStorageSize,
+        Memory->TransientStorageCommitted, sizeof(transient_state), Memory->CommitMemory);
+
+    game_state *GameState = (game_state *)Memory->PerminantStorage;
+    if (!GameState->Initialized)
+    {
+        InitializeGame(Input, GameState);
+    }
+
+    transient_state *TranState = (transient_state *)Memory->TransientStorage;
+    if (!TranState->Initialized)
+    {
+        InitializeArena(&TranState->Arena,
+                        Memory->TransientStorageSize - sizeof(transient_state),
+                        (u8 *)Memory->TransientStorage + sizeof(transient_state),
+                        Memory->TransientStorageCommitted - sizeof(transient_state),
+                        Memory->CommitMemory);
+        InitializeRewind(&TranState->Rewind, &TranState->Arena, sizeof(game_state));
+        InitializeParticles(&TranState->Particles, &TranState->Arena, MAX_PARTICLES);
+        TranState->Initialized = true;
+    }
+
+    // NOTE: (Marcus) Holding R plays the game backwards one frame at a time.
+    // Not in networked play, the other side would not rewind with us.
+    rewind_buffer *Rewind = &TranState->Rewind;
+    app_frame_stats *Stats = &Memory->Stats;
+    u64 RewindStart = __rdtsc();
+    bool CanRewind = (Input.PlayerCount == 0);
+    Stats->FireEventTimestamp = 0;
+    Stats->UpdateCycles = 0;
+    Stats->CollisionCycles = 0;
+    Stats->Counters.CollisionPairsTested = 0;
+    Stats->Counters.CollisionPairsHit = 0;
+    if (CanRewind && KeyIsDown(&Input, (u32)'R') && RewindStepBack(Rewind, GameState))
+    {
+        Stats->RewindRestoreCycles = __rdtsc() - RewindStart;
+    }
+    else if (!Input.Stalled)
+    {
+        particle_pool *Particles = &TranState->Particles;
+        Particles->Limit = Input.Quality.SkipEffects ? 0 : Particles->Capacity;
+        if (Input.Quality.ParticleCap && Input.Quality.ParticleCap < Particles->Limit)
+        {
+            Particles->Limit = Input.Quality.ParticleCap;
+        }
+
+        u64 UpdateStart = __rdtsc();
+        UpdateGame(Input, GameState, AudioCommands, Particles, &Memory->Stats);
+        Stats->UpdateCycles = __rdtsc() - UpdateStart;
+
+        // NOTE: Nothing can rewind in networked play, so there is no
+        // history worth paying for.
+        Stats->RewindSnapshotCycles = 0;
+        if (CanRewind)
+        {
+            u64 SnapshotStart = __rdtsc();
+            RewindSnapshot(Rewind, GameState);
+            Stats->RewindSnapshotCycles = __rdtsc() - SnapshotStart;
+        }
+    }
+    Stats->RewindFrameCount = Rewind->FrameCount;
+    Stats->RewindBytesInUse = Rewind->BytesInUse;
+
+    particle_pool *Particles = &TranState->Particles;
+    u64 ParticlesStart = __rdtsc();
+    UpdateParticles(Particles, Input.FrameEllapsedSecs);
+    Stats->UpdateCycles += __rdtsc() - ParticlesStart;
 
     render_clear_color *Clear = PushRenderCommand(RenderCommands, RenderCommand_Clear, render_clear_color);
     Clear->Color = Black;
 
-    render_rectangle *Rectangle = PushRenderCommand(RenderCommands, RenderCommand_Rectangle, render_rectangle);
-    Rectangle->X = GameState->Player.P.X;
-    Rectangle->Y = GameState->Player.P.Y;
-    Rectangle->Width = GameState->Player.Dim.Width;
-    Rectangle->Height = GameState->Player.Dim.Height;
-    Rectangle->Color = RGB_U32(0, 255, 150);
+    // NOTE: (Marcus) Layers are opaque, so fleets go down first and
+    // everything else draws over them.
+    for (u32 FleetIndex = 0; FleetIndex < GameState->FleetCount; ++FleetIndex)
+    {
+        invader_fleet *Fleet = &GameState->Fleets[FleetIndex];
+        if (!FleetIsActive(Input, Fleet)) continue;
 
-    for (u32 Index = 0; 
-         Index < ArraySize(GameState->Invaders); 
-         ++Index)
+        fleet_layer *Layer = &TranState->FleetLayers[FleetIndex];
+        if (!Layer->IsValid || Layer->DeadInvaders != Fleet->DeadInvaders)
+        {
+            RasterizeFleetLayer(GameState, Fleet, Layer, &TranState->Arena);
+        }
+
+        render_bitmap *Bitmap = PushRenderCommand(RenderCommands, RenderCommand_Bitmap, render_bitmap);
+        Bitmap->X = (i32)Fleet->P.X;
+        Bitmap->Y = (i32)Fleet->P.Y;
+        Bitmap->Width = Layer->Width;
+        Bitmap->Height = Layer->Height;
+        Bitmap->Pitch = Layer->Width;
+        Bitmap->Pixels = Layer->Pixels;
+    }
+
+    u32 PlayerColors[MAX_PLAYERS] = {RGB_U32(0, 255, 150), RGB_U32(255, 200, 0)};
+    for (u32 PlayerIndex = 0; PlayerIndex < GameState->PlayerCount; ++PlayerIndex)
     {
-        entity Invader = GameState->Invaders[Index];
-        if (!Invader.State) continue;
+        entity *Player = &GameState->Players[PlayerIndex];
+        render_rectangle *Rectangle = PushRenderCommand(RenderCommands, RenderCommand_Rectangle, render_rectangle);
+        Rectangle->X = Player->P.X;
+        Rectangle->Y = Player->P.Y;
+        Rectangle->Width = Player->Dim.Width;
+        Rectangle->Height = Player->Dim.Height;
+        Rectangle->Color = PlayerColors[PlayerIndex];
+    }
 
-        render_rectangle *Rect = PushRenderCommand(RenderCommands, RenderCommand_Rectangle, render_rectangle);
-        Rect->Color = RGB_U32(0, 150, 255);
-        Rect->X = Invader.P.X;
-        Rect->Y = Invader.P.Y;
-        Rect->Width = Invader.Dim.Width;
-        Rect->Height = Invader.Dim.Height; 
+    if (Particles->Count && !Input.Quality.SkipEffects)
+    {
+        render_particle_batch *Batch = PushRenderCommand(RenderCommands, RenderCommand_ParticleBatch,
+                                                         render_particle_batch);
+        Batch->Count = Particles->Count;
+        Batch->Size = 2;
+        Batch->X = Particles->PX;
+        Batch->Y = Particles->PY;
+        Batch->Life = Particles->Life;
+        Batch->Color = Particles->Color;
     }
 
     for (u32 Index = 0; 
@@ -421,14 +948,6 @@ GameUpdateAndRender(app_input Input, app_memory *Memory, render_commands *Render
         Rect->Height = Missle.Dim.Height; 
     }
 
-    level_outcome_type Outcome = GameState->Fleet.DeadInvaders >= GameState->Fleet.InvaderCount
-        ? LevelOutcome_YouWin
-        : LevelOutcome_Unknown;
-    Outcome = Fails.CollisionCount > 0
-        ? LevelOutcome_YouLose
-        : Outcome;
-    GameState->LevelOutcome = Outcome;
-
     if (GameState->LevelOutcome)
     {
         u32 Color = GameState->LevelOutcome == LevelOutcome_YouWin
@@ -444,5 +963,29 @@ GameUpdateAndRender(app_input Input, app_memory *Memory, render_commands *Render
         Rect->Height = 40;
     }
 
+    // NOTE: (Marcus) Players are never marked dead, there is one per
+    // player slot for as long as the game runs.
+    app_counters *Counters = &Stats->Counters;
+    Counters->LivePlayers = GameState->PlayerCount;
+    Counters->LivePlayerMissiles = CountLiveEntities(GameState->PlayerMissiles,
+                                                     ArraySize(GameState->PlayerMissiles));
+    Counters->LiveInvaderMissiles = CountLiveEntities(GameState->InvaderMissiles,
+                                                      ArraySize(GameState->InvaderMissiles));
+    Counters->LiveInvaders = 0;
+    for (u32 FleetIndex = 0; FleetIndex < GameState->FleetCount; ++FleetIndex)
+    {
+        invader_fleet *Fleet = &GameState->Fleets[FleetIndex];
+        Counters->LiveInvaders += Fleet->InvaderCount - Fleet->DeadInvaders;
+    }
+    Counters->LiveParticles = Particles->Count;
+
+    Counters->RenderCommands = RenderCommands->PushBufferEntryCount;
+    Counters->RenderBytesUsed = RenderCommands->PushBufferUsed;
+    Counters->RenderBytesSize = RenderCommands->PushBufferSize;
+    Counters->PermanentUsed = sizeof(game_state);
+    Counters->PermanentSize = Memory->PerminantStorageSize;
+    Counters->TransientUsed = sizeof(transient_state) + TranState->Arena.Used;
+    Counters->TransientSize = Memory->TransientStorageSize;
+
     return;
 }
\ No newline at end of file
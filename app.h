@@ -1,5 +1,12 @@
 #ifndef APP_H
 #include <stdint.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
 
 #define APP_NAME "Not Space Invaders"
 
@@ -19,11 +26,60 @@ typedef size_t umi;
 
 #define Assert(Expression) if (!(Expression)) {*(int *)0 = 0;}
 
+#if defined(_MSC_VER)
+#define CompletePreviousWritesBeforeFutureWrites _WriteBarrier(); _mm_sfence()
+#define CompletePreviousReadsBeforeFutureReads _ReadBarrier()
+#else
+#define CompletePreviousWritesBeforeFutureWrites asm volatile("" ::: "memory")
+#define CompletePreviousReadsBeforeFutureReads asm volatile("" ::: "memory")
+#endif
+
+#define Kilobytes(Value) ((Value)*1024LL)
+#define Megabytes(Value) (Kilobytes(Value)*1024LL)
+#define Gigabytes(Value) (Megabytes(Value)*1024LL)
+
+#define AlignPow2(Value, Alignment) (((Value) + ((Alignment) - 1)) & ~((umi)(Alignment) - 1))
+
 struct app_key_state
 {
     bool IsDown;
 };
 
+// NOTE: (Marcus) Every key transition the platform saw since the last
+// frame, in order.  TimeSecs is when it happened inside the frame being
+// simulated, from 0 to FrameEllapsedSecs.  Timestamp is the platform wall
+// clock, the game only hands it back for latency measurements.
+struct app_input_event
+{
+    u32 KeyCode;
+    bool IsDown;
+    float TimeSecs;
+    u64 Timestamp;
+};
+
+// NOTE: (Marcus) Networked play drives every player from a few buttons a
+// tick instead of the keyboard, that is all that goes over the wire.
+enum app_button
+{
+    Button_Left  = (1 << 0),
+    Button_Right = (1 << 1),
+    Button_Fire  = (1 << 2),
+
+    Button_BitCount = 3
+};
+
+// NOTE: (Marcus) What the platform lets the game spend this frame, all
+// zero is full quality.  ParticleCap 0 means no cap beyond the pool size.
+// SkipCollision is only ever set when nobody else runs the same simulation.
+struct app_quality
+{
+    u32 ParticleCap;
+    bool SkipEffects;
+    bool SkipCollision;
+};
+
+#define MAX_PLAYERS 2
+#define MAX_INPUT_EVENTS 64
 struct app_input 
 {
     int ScreenWidth;
@@ -31,24 +87,189 @@ struct app_input
     float FrameEllapsedSecs;
     app_key_state KeyState[256];
     app_key_state OldKeyState[256];
+
+    u32 EventCount;
+    app_input_event Events[MAX_INPUT_EVENTS];
+
+    // NOTE: PlayerCount 0 is one local player on the keyboard.  Otherwise
+    // each player is PlayerButtons held for the whole frame, and Stalled
+    // means the frame only renders because a remote input is late.
+    u32 PlayerCount;
+    u8 PlayerButtons[MAX_PLAYERS];
+    bool Stalled;
+
+    app_quality Quality;
+};
+
+// NOTE: (Marcus) Work queue the platform runs on its worker threads.
+// Entries are added from one thread only.
+struct platform_work_queue;
+#define PLATFORM_WORK_QUEUE_CALLBACK(name) void name(platform_work_queue *Queue, void *Data)
+typedef PLATFORM_WORK_QUEUE_CALLBACK(platform_work_queue_callback);
+
+typedef void platform_add_entry(platform_work_queue *Queue, platform_work_queue_callback *Callback, void *Data);
+typedef void platform_complete_all_work(platform_work_queue *Queue);
+
+// NOTE: (Marcus) Counts of what the last frame did.  The game fills in
+// everything but the Platform ones.  They are published every frame for
+// outside tools, see app_counters_block, so fields are only ever added at
+// the end and are all u64.
+#define APP_COUNTERS_VERSION 1
+struct app_counters
+{
+    // NOTE: Platform
+    u64 FrameIndex;
+    u64 WorkMicroseconds;
+    u64 PixelsFilled;
+
+    u64 LivePlayers;
+    u64 LivePlayerMissiles;
+    u64 LiveInvaders;
+    u64 LiveInvaderMissiles;
+    u64 LiveParticles;
+
+    u64 CollisionPairsTested;
+    u64 CollisionPairsHit;
+
+    u64 RenderCommands;
+    u64 RenderBytesUsed;
+    u64 RenderBytesSize;
+
+    u64 PermanentUsed;
+    u64 PermanentSize;
+    u64 TransientUsed;
+    u64 TransientSize;
+};
+
+// NOTE: In field order, for CSV headers and readers.
+global const char *AppCounterNames[] = {
+    "FrameIndex", "WorkMicroseconds", "PixelsFilled",
+    "LivePlayers", "LivePlayerMissiles", "LiveInvaders", "LiveInvaderMissiles", "LiveParticles",
+    "CollisionPairsTested", "CollisionPairsHit",
+    "RenderCommands", "RenderBytesUsed", "RenderBytesSize",
+    "PermanentUsed", "PermanentSize", "TransientUsed", "TransientSize",
+};
+#define APP_COUNTER_COUNT (sizeof(app_counters) / sizeof(u64))
+
+// NOTE: (Marcus) Shared memory block the counters are published through.
+// A seqlock: the writer makes Sequence odd, copies, then makes it even
+// again.  Readers never block the writer, they retry a copy that a write
+// overlapped.  Version and Size let a reader check it agrees on the layout.
+// The name is formatted with the game's process id.
+#define APP_COUNTERS_SHARED_NAME "Local\\NsiCounters%u"
+struct app_counters_block
+{
+    u32 volatile Sequence;
+    u32 Version;
+    u32 Size;
+    u32 Reserved;
+    app_counters Counters;
+};
+
+inline void
+PublishCounters(app_counters_block *Block, app_counters *Counters)
+{
+    Block->Sequence = Block->Sequence + 1;
+    CompletePreviousWritesBeforeFutureWrites;
+    Block->Counters = *Counters;
+    CompletePreviousWritesBeforeFutureWrites;
+    Block->Sequence = Block->Sequence + 1;
+}
+
+// NOTE: False if every attempt overlapped a write, try again later.
+inline bool
+SampleCounters(app_counters_block *Block, app_counters *Counters)
+{
+    for (u32 Attempt = 0; Attempt < 64; ++Attempt)
+    {
+        u32 Before = Block->Sequence;
+        CompletePreviousReadsBeforeFutureReads;
+        if (Before & 1) continue;
+
+        *Counters = Block->Counters;
+        CompletePreviousReadsBeforeFutureReads;
+        if (Block->Sequence == Before) return(true);
+    }
+    return(false);
+}
+
+struct app_frame_stats
+{
+    u64 RewindSnapshotCycles;
+    u64 RewindRestoreCycles;
+    u32 RewindFrameCount;
+    umi RewindBytesInUse;
+
+    // NOTE: Timestamp of the key event behind the last shot fired on the
+    // press itself, 0 if there was none this frame.
+    u64 FireEventTimestamp;
+
+    // NOTE: Update includes collision and the particle update.
+    u64 UpdateCycles;
+    u64 CollisionCycles;
+
+    app_counters Counters;
 };
 
+// NOTE: (Marcus) Storage is reserved address space, only the first
+// Committed bytes are backed by memory.  Anything past that has to go
+// through CommitMemory before it is touched.
+#define PLATFORM_COMMIT_MEMORY(name) bool name(void *Memory, umi Size)
+typedef PLATFORM_COMMIT_MEMORY(platform_commit_memory);
+
+#define MEMORY_COMMIT_GRANULARITY Kilobytes(64)
+
+inline umi
+CommitToFit(void *Base, umi Reserved, umi Committed, umi Needed, platform_commit_memory *Commit)
+{
+    umi Result = Committed;
+    if (Needed > Committed)
+    {
+        Assert(Needed <= Reserved);
+        Result = AlignPow2(Needed, MEMORY_COMMIT_GRANULARITY);
+        Result = (Result > Reserved) ? Reserved : Result;
+
+        bool WasCommitted = Commit((u8 *)Base + Committed, Result - Committed);
+        Assert(WasCommitted);
+    }
+    return(Result);
+}
+
 struct app_memory
 {
     umi PerminantStorageSize;
+    umi PerminantStorageCommitted;
     void *PerminantStorage;
 
     umi TransientStorageSize;
+    umi TransientStorageCommitted;
     void *TransientStorage;
+
+    platform_commit_memory *CommitMemory;
+
+    app_frame_stats Stats;
 };
 
 struct memory_arena
 {
     umi Size;
     umi Used;
+    umi Committed;
     void *Memory;
+    platform_commit_memory *Commit;
 };
 
+inline void
+InitializeArena(memory_arena *Arena, umi Size, void *Memory,
+                umi Committed, platform_commit_memory *Commit)
+{
+    Arena->Size = Size;
+    Arena->Used = 0;
+    Arena->Committed = Committed;
+    Arena->Memory = Memory;
+    Arena->Commit = Commit;
+}
+
 #define ArraySize(Array) (sizeof(Array)/sizeof(Array[0]))
 
 #define PushStruct(Arena, type) (type *)PushSize(Arena, sizeof(type))
@@ -57,6 +278,8 @@ inline void *
 PushSize(memory_arena *Arena, umi Size)
 {
     Assert(Arena->Size >= (Arena->Used + Size));
+    Arena->Committed = CommitToFit(Arena->Memory, Arena->Size, Arena->Committed,
+                                   Arena->Used + Size, Arena->Commit);
     void *Result = ((u8 *)Arena->Memory + Arena->Used);
     Arena->Used += Size;
     return(Result);
@@ -99,7 +322,9 @@ enum render_command_type
 {
     RenderCommand_Unknown,
     RenderCommand_Clear,
-    RenderCommand_Rectangle
+    RenderCommand_Rectangle,
+    RenderCommand_ParticleBatch,
+    RenderCommand_Bitmap
 };
 
 struct render_command_header
@@ -115,19 +340,43 @@ struct render_clear_color
 
 struct render_rectangle
 {
-    u32 X, Y;
+    i32 X, Y;
     u32 Width, Height;
     u32 Color;
 };
 
+// NOTE: (Marcus) Points straight at the particle pool arrays, which stay
+// put until the next update, and is drawn additively.
+struct render_particle_batch
+{
+    u32 Count;
+    u32 Size;
+    float *X;
+    float *Y;
+    float *Life;
+    u32 *Color;
+};
+
+// NOTE: (Marcus) Opaque copy, one span per row.  Pitch is in pixels.
+struct render_bitmap
+{
+    i32 X, Y;
+    u32 Width, Height;
+    u32 Pitch;
+    u32 *Pixels;
+};
+
 struct render_commands
 {
     umi PushBufferSize;
     umi PushBufferUsed;
     umi PushBufferEntryCount;
     void *PushBuffer;
+
+    umi PushBufferCommitted;
+    platform_commit_memory *Commit;
 };
-#define CreateRenderCommands(Size, Buffer) {Size, 0, 0, Buffer}
+#define CreateRenderCommands(Size, Buffer, Committed, Commit) {Size, 0, 0, Buffer, Committed, Commit}
 
 #define PushRenderCommand(Commands, Type, type) (type *)PushRenderCommand_(Commands, Type, sizeof(type))
 inline void *
@@ -135,6 +384,9 @@ PushRenderCommand_(render_commands *Commands, render_command_type Type, umi Size
 {
     u64 TotalUsed = (Commands->PushBufferUsed + sizeof(render_command_header) + Size);
     Assert(Commands->PushBufferSize >= TotalUsed);
+    Commands->PushBufferCommitted = CommitToFit(Commands->PushBuffer, Commands->PushBufferSize,
+                                                Commands->PushBufferCommitted, TotalUsed,
+                                                Commands->Commit);
     
     void *Result = ((u8 *)Commands->PushBuffer + Commands->PushBufferUsed);
     render_command_header *Header = (render_command_header *)Result; 
@@ -147,5 +399,41 @@ PushRenderCommand_(render_commands *Commands, render_command_type Type, umi Size
     return(Result);
 }
 
+enum sound_id
+{
+    Sound_None,
+    Sound_Laser,
+    Sound_Explosion,
+
+    Sound_Count
+};
+
+struct audio_play_sound
+{
+    u32 SoundID;
+    float Volume;
+    float Pan; // -1 is hard left, 1 is hard right
+};
+
+#define AUDIO_MAX_COMMANDS 64
+struct audio_commands
+{
+    u32 Count;
+    audio_play_sound Commands[AUDIO_MAX_COMMANDS];
+};
+
+inline void
+PushSound(audio_commands *Commands, sound_id SoundID, float Volume, float Pan)
+{
+    // NOTE: (Marcus) Dropping a sound is better than stalling the frame.
+    if (Commands->Count < ArraySize(Commands->Commands))
+    {
+        audio_play_sound *Sound = &Commands->Commands[Commands->Count++];
+        Sound->SoundID = SoundID;
+        Sound->Volume = Volume;
+        Sound->Pan = Pan;
+    }
+}
+
 #define APP_H
 #endif
\ No newline at end of file
@@ -0,0 +1,224 @@
+// NOTE: (Marcus) Batch simulation steps thousands of independent games at
+// once for automated agents.  UpdateGame only reads app_input and writes
+// game_state, so each instance is just a game_state in one contiguous
+// array.  Nothing is rendered unless an observation raster is asked for,
+// and there is no audio, particles or rewind.
+//
+// An instance that finished on the last step (won or lost) starts a fresh
+// level on the next one.
+
+#define BATCH_INSTANCES_PER_JOB 64
+#define BATCH_REWARD_PER_KILL 1.0f
+#define BATCH_REWARD_WIN 10.0f
+#define BATCH_REWARD_LOSE -10.0f
+
+struct batch_sim;
+
+struct batch_job
+{
+    batch_sim *Batch;
+    u32 FirstInstance;
+    u32 InstanceCount;
+};
+
+struct batch_sim
+{
+    u32 InstanceCount;
+    u32 ScreenWidth;
+    u32 ScreenHeight;
+    float StepSecs;
+
+    // NOTE: 0x0 means no observations.
+    u32 ObservationWidth;
+    u32 ObservationHeight;
+
+    game_state *States;
+
+    // NOTE: Only valid during BatchStep.
+    app_input *Actions;
+    float *Rewards;
+    u32 *Outcomes;
+    u8 *Observations;
+
+    platform_work_queue *Queue;
+    platform_add_entry *AddEntry;
+    platform_complete_all_work *CompleteAllWork;
+
+    u32 JobCount;
+    batch_job *Jobs;
+};
+
+inline u32
+TotalDeadInvaders(game_state *GameState)
+{
+    u32 Result = 0;
+    for (u32 Index = 0; Index < GameState->FleetCount; ++Index)
+    {
+        Result += GameState->Fleets[Index].DeadInvaders;
+    }
+    return(Result);
+}
+
+inline void
+ObservationRect(render_target *Target, float ScaleX, float ScaleY, v2 P, v2 Dim, u8 Value)
+{
+    i32 MinX = (i32)(P.X * ScaleX);
+    i32 MinY = (i32)(P.Y * ScaleY);
+    i32 MaxX = (i32)((P.X + Dim.Width) * ScaleX) + 1;
+    i32 MaxY = (i32)((P.Y + Dim.Height) * ScaleY) + 1;
+    DrawRectangle<pixel_gray8, Blend_Opaque>(Target, MinX, MinY, MaxX - MinX, MaxY - MinY,
+                                             RGB_U32(Value, Value, Value));
+}
+
+// NOTE: (Marcus) One byte per pixel, nearest scaled down from screen space.
+// Player 255, player missiles 192, invaders 128.
+internal void
+RenderObservation(batch_sim *Batch, game_state *GameState, u8 *Pixels)
+{
+    render_target Target = {};
+    Target.Memory = Pixels;
+    Target.Width = Batch->ObservationWidth;
+    Target.Height = Batch->ObservationHeight;
+    Target.Pitch = Batch->ObservationWidth;
+    float ScaleX = (float)Target.Width / (float)Batch->ScreenWidth;
+    float ScaleY = (float)Target.Height / (float)Batch->ScreenHeight;
+    FillRectangle<pixel_gray8, Blend_Opaque, false, Span_Wide>(
+        &Target, 0, 0, (i32)Target.Width, (i32)Target.Height, 0);
+
+    for (u32 FleetIndex = 0; FleetIndex < GameState->FleetCount; ++FleetIndex)
+    {
+        invader_fleet *Fleet = &GameState->Fleets[FleetIndex];
+        if (Fleet->DeadInvaders >= Fleet->InvaderCount || (Fleet->P.Y + Fleet->Dim.Height) < 0) continue;
+
+        entity *Invaders = GameState->Invaders + Fleet->FirstInvader;
+        for (u32 Index = 0; Index < Fleet->InvaderCount; ++Index)
+        {
+            if (IsDead(Invaders[Index].State)) continue;
+            ObservationRect(&Target, ScaleX, ScaleY,
+                            Fleet->P + Invaders[Index].P, Invaders[Index].Dim, 128);
+        }
+    }
+
+    for (u32 Index = 0; Index < ArraySize(GameState->PlayerMissiles); ++Index)
+    {
+        entity *Missile = &GameState->PlayerMissiles[Index];
+        if (IsDead(Missile->State)) continue;
+        ObservationRect(&Target, ScaleX, ScaleY, Missile->P, Missile->Dim, 192);
+    }
+
+    for (u32 Index = 0; Index < GameState->PlayerCount; ++Index)
+    {
+        entity *Player = &GameState->Players[Index];
+        ObservationRect(&Target, ScaleX, ScaleY, Player->P, Player->Dim, 255);
+    }
+}
+
+internal PLATFORM_WORK_QUEUE_CALLBACK(DoBatchJob)
+{
+    batch_job *Job = (batch_job *)Data;
+    batch_sim *Batch = Job->Batch;
+
+    // NOTE: Effects go nowhere.  A zero capacity pool drops every burst.
+    audio_commands AudioCommands = {};
+    particle_pool Particles = {};
+    app_frame_stats Stats = {};
+
+    u32 ObservationSize = Batch->ObservationWidth * Batch->ObservationHeight;
+    for (u32 Instance = Job->FirstInstance;
+         Instance < (Job->FirstInstance + Job->InstanceCount);
+         ++Instance)
+    {
+        game_state *GameState = &Batch->States[Instance];
+        app_input Input = Batch->Actions[Instance];
+        Input.ScreenWidth = Batch->ScreenWidth;
+        Input.ScreenHeight = Batch->ScreenHeight;
+        Input.FrameEllapsedSecs = Batch->StepSecs;
+        Input.Quality = {};
+
+        if (!GameState->Initialized || GameState->LevelOutcome != LevelOutcome_Unknown)
+        {
+            memset(GameState, 0, sizeof(game_state));
+            InitializeGame(Input, GameState);
+        }
+
+        u32 DeadBefore = TotalDeadInvaders(GameState);
+        UpdateGame(Input, GameState, &AudioCommands, &Particles, &Stats);
+        AudioCommands.Count = 0;
+
+        float Reward = BATCH_REWARD_PER_KILL * (float)(TotalDeadInvaders(GameState) - DeadBefore);
+        if (GameState->LevelOutcome == LevelOutcome_YouWin) Reward += BATCH_REWARD_WIN;
+        if (GameState->LevelOutcome == LevelOutcome_YouLose) Reward += BATCH_REWARD_LOSE;
+
+        Batch->Rewards[Instance] = Reward;
+        Batch->Outcomes[Instance] = GameState->LevelOutcome;
+        if (ObservationSize && Batch->Observations)
+        {
+            RenderObservation(Batch, GameState, Batch->Observations + Instance*ObservationSize);
+        }
+    }
+}
+
+// NOTE: (Marcus) Memory has to hold BatchMemorySize bytes, zeroed.
+inline umi
+BatchMemorySize(u32 InstanceCount)
+{
+    u32 JobCount = (InstanceCount + BATCH_INSTANCES_PER_JOB - 1) / BATCH_INSTANCES_PER_JOB;
+    umi Result = (sizeof(batch_sim) +
+                  InstanceCount*sizeof(game_state) +
+                  JobCount*sizeof(batch_job));
+    return(Result);
+}
+
+internal batch_sim *
+BatchInitialize(void *Memory, u32 InstanceCount, u32 ScreenWidth, u32 ScreenHeight,
+                u32 ObservationWidth, u32 ObservationHeight)
+{
+    memory_arena Arena;
+    umi Size = BatchMemorySize(InstanceCount);
+    InitializeArena(&Arena, Size, Memory, Size, 0);
+
+    batch_sim *Batch = PushStruct(&Arena, batch_sim);
+    Batch->InstanceCount = InstanceCount;
+    Batch->ScreenWidth = ScreenWidth;
+    Batch->ScreenHeight = ScreenHeight;
+    Batch->StepSecs = 1.0f / 60.0f;
+    Batch->ObservationWidth = ObservationWidth;
+    Batch->ObservationHeight = ObservationHeight;
+    Batch->States = PushArray(&Arena, InstanceCount, game_state);
+
+    Batch->JobCount = (InstanceCount + BATCH_INSTANCES_PER_JOB - 1) / BATCH_INSTANCES_PER_JOB;
+    Batch->Jobs = PushArray(&Arena, Batch->JobCount, batch_job);
+    for (u32 JobIndex = 0; JobIndex < Batch->JobCount; ++JobIndex)
+    {
+        batch_job *Job = &Batch->Jobs[JobIndex];
+        Job->Batch = Batch;
+        Job->FirstInstance = JobIndex * BATCH_INSTANCES_PER_JOB;
+        Job->InstanceCount = InstanceCount - Job->FirstInstance;
+        if (Job->InstanceCount > BATCH_INSTANCES_PER_JOB)
+        {
+            Job->InstanceCount = BATCH_INSTANCES_PER_JOB;
+        }
+    }
+
+    return(Batch);
+}
+
+// NOTE: (Marcus) Actions, Rewards and Outcomes hold one entry per instance,
+// Observations holds InstanceCount*ObservationWidth*ObservationHeight
+// bytes or is null.  Screen size and FrameEllapsedSecs in the actions are
+// ignored, every instance steps StepSecs.  Actions with no events just use
+// KeyState for the whole step.
+internal void
+BatchStep(batch_sim *Batch, app_input *Actions, float *Rewards, u32 *Outcomes, u8 *Observations)
+{
+    Batch->Actions = Actions;
+    Batch->Rewards = Rewards;
+    Batch->Outcomes = Outcomes;
+    Batch->Observations = Observations;
+
+    for (u32 JobIndex = 0; JobIndex < Batch->JobCount; ++JobIndex)
+    {
+        Batch->AddEntry(Batch->Queue, DoBatchJob, &Batch->Jobs[JobIndex]);
+    }
+    Batch->CompleteAllWork(Batch->Queue);
+}
@@ -0,0 +1,234 @@
+// NOTE: (Marcus) Frame governor.  When the work in a frame keeps running
+// over budget it sheds quality, one step at a time, picking the step that
+// relieves whichever stage is costing the most:
+//
+//   update    - cap particles, then stop effects altogether
+//   collision - test missiles every other frame (never in networked play)
+//   raster    - cap particles, stop effects, then half resolution (never
+//               while capturing)
+//
+// Effects only go after the particle cap has been tried.  Whatever stage
+// is to blame, any step still available is taken before giving up.
+// Steps are undone newest first once there is clear headroom again.  The
+// thresholds and the wait after every change keep it from flapping.  Each
+// decision is written to Log for the platform to print.
+
+#define GOVERNOR_OVER_BUDGET 0.9f
+#define GOVERNOR_UNDER_BUDGET 0.5f
+#define GOVERNOR_OVER_FRAMES 10
+#define GOVERNOR_UNDER_FRAMES 120
+#define GOVERNOR_SETTLE_FRAMES 30
+#define GOVERNOR_PARTICLE_CAP (32*1024)
+
+enum governor_step
+{
+    GovernorStep_CapParticles,
+    GovernorStep_SkipEffects,
+    GovernorStep_SlowCollision,
+    GovernorStep_HalfResolution,
+
+    GovernorStep_Count
+};
+
+global const char *GovernorStepNames[GovernorStep_Count] = {
+    "cap particles",
+    "skip effects",
+    "collide every other frame",
+    "half resolution",
+};
+
+// NOTE: Seconds of work, not counting the wait for the frame rate.
+struct governor_frame
+{
+    float TotalSecs;
+    float UpdateSecs;
+    float CollisionSecs;
+    float RasterSecs;
+};
+
+struct frame_governor
+{
+    float BudgetSecs;
+    bool AllowSlowCollision;
+    bool AllowHalfResolution;
+
+    // NOTE: Exponential moving averages, a single spike is not load.
+    governor_frame Average;
+
+    u32 FrameIndex;
+    u32 OverFrames;
+    u32 UnderFrames;
+    u32 SettleFrames;
+
+    u32 StepCount;
+    governor_step Steps[GovernorStep_Count];
+
+    u32 DecisionCount;
+    char Log[256];
+};
+
+internal void
+InitializeGovernor(frame_governor *Governor, float BudgetSecs)
+{
+    *Governor = {};
+    Governor->BudgetSecs = BudgetSecs;
+    Governor->AllowSlowCollision = true;
+    Governor->AllowHalfResolution = true;
+}
+
+inline bool
+GovernorHasStep(frame_governor *Governor, governor_step Step)
+{
+    bool Result = false;
+    for (u32 Index = 0; Index < Governor->StepCount; ++Index)
+    {
+        Result |= (Governor->Steps[Index] == Step);
+    }
+    return(Result);
+}
+
+inline bool
+GovernorCanTake(frame_governor *Governor, governor_step Step)
+{
+    bool Allowed = true;
+    if (Step == GovernorStep_SlowCollision) Allowed = Governor->AllowSlowCollision;
+    if (Step == GovernorStep_HalfResolution) Allowed = Governor->AllowHalfResolution;
+    if (Step == GovernorStep_SkipEffects) Allowed = GovernorHasStep(Governor, GovernorStep_CapParticles);
+    bool Result = Allowed && !GovernorHasStep(Governor, Step);
+    return(Result);
+}
+
+// NOTE: Preferred steps for the stage costing the most, best first.
+internal bool
+GovernorPickStep(frame_governor *Governor, governor_step *Result)
+{
+    governor_frame *Average = &Governor->Average;
+    float UpdateOnly = Average->UpdateSecs - Average->CollisionSecs;
+
+    governor_step Preferred[4] = {};
+    if (Average->RasterSecs >= UpdateOnly && Average->RasterSecs >= Average->CollisionSecs)
+    {
+        governor_step Raster[4] = {GovernorStep_CapParticles, GovernorStep_SkipEffects,
+                                   GovernorStep_HalfResolution, GovernorStep_SlowCollision};
+        memcpy(Preferred, Raster, sizeof(Preferred));
+    }
+    else if (Average->CollisionSecs >= UpdateOnly)
+    {
+        governor_step Collision[4] = {GovernorStep_SlowCollision, GovernorStep_CapParticles,
+                                      GovernorStep_SkipEffects, GovernorStep_HalfResolution};
+        memcpy(Preferred, Collision, sizeof(Preferred));
+    }
+    else
+    {
+        governor_step Update[4] = {GovernorStep_CapParticles, GovernorStep_SkipEffects,
+                                   GovernorStep_SlowCollision, GovernorStep_HalfResolution};
+        memcpy(Preferred, Update, sizeof(Preferred));
+    }
+
+    for (u32 Index = 0; Index < ArraySize(Preferred); ++Index)
+    {
+        if (GovernorCanTake(Governor, Preferred[Index]))
+        {
+            *Result = Preferred[Index];
+            return(true);
+        }
+    }
+    return(false);
+}
+
+internal void
+GovernorLog(frame_governor *Governor, const char *Action, governor_step Step)
+{
+    governor_frame *Average = &Governor->Average;
+    ++Governor->DecisionCount;
+    wsprintf(Governor->Log,
+             "Governor: frame %d work %d us of %d us (update %d collision %d raster %d) %s %s\n",
+             Governor->FrameIndex,
+             (u32)(Average->TotalSecs * 1000000.0f), (u32)(Governor->BudgetSecs * 1000000.0f),
+             (u32)(Average->UpdateSecs * 1000000.0f), (u32)(Average->CollisionSecs * 1000000.0f),
+             (u32)(Average->RasterSecs * 1000000.0f), Action, GovernorStepNames[Step]);
+}
+
+// NOTE: (Marcus) Called once a frame with what that frame cost.  Returns
+// true when it changed something, Log then says what and why.
+internal bool
+UpdateGovernor(frame_governor *Governor, governor_frame *Frame)
+{
+    float Blend = 0.1f;
+    governor_frame *Average = &Governor->Average;
+    Average->TotalSecs += Blend * (Frame->TotalSecs - Average->TotalSecs);
+    Average->UpdateSecs += Blend * (Frame->UpdateSecs - Average->UpdateSecs);
+    Average->CollisionSecs += Blend * (Frame->CollisionSecs - Average->CollisionSecs);
+    Average->RasterSecs += Blend * (Frame->RasterSecs - Average->RasterSecs);
+    ++Governor->FrameIndex;
+
+    // NOTE: A step that is no longer allowed, like half resolution once a
+    // capture starts, comes off straight away.
+    for (u32 Index = 0; Index < Governor->StepCount; ++Index)
+    {
+        governor_step Step = Governor->Steps[Index];
+        bool Allowed = !((Step == GovernorStep_SlowCollision && !Governor->AllowSlowCollision) ||
+                         (Step == GovernorStep_HalfResolution && !Governor->AllowHalfResolution));
+        if (!Allowed)
+        {
+            Governor->Steps[Index] = Governor->Steps[--Governor->StepCount];
+            GovernorLog(Governor, "not allowed, dropped", Step);
+            return(true);
+        }
+    }
+
+    if (Governor->SettleFrames)
+    {
+        --Governor->SettleFrames;
+        return(false);
+    }
+
+    bool Over = (Frame->TotalSecs > GOVERNOR_OVER_BUDGET * Governor->BudgetSecs);
+    bool Under = (Average->TotalSecs < GOVERNOR_UNDER_BUDGET * Governor->BudgetSecs);
+    Governor->OverFrames = Over ? Governor->OverFrames + 1 : 0;
+    Governor->UnderFrames = Under ? Governor->UnderFrames + 1 : 0;
+
+    bool Result = false;
+    governor_step Step;
+    if (Governor->OverFrames >= GOVERNOR_OVER_FRAMES && GovernorPickStep(Governor, &Step))
+    {
+        Governor->Steps[Governor->StepCount++] = Step;
+        GovernorLog(Governor, "over budget, shed", Step);
+        Result = true;
+    }
+    else if (Governor->UnderFrames >= GOVERNOR_UNDER_FRAMES && Governor->StepCount)
+    {
+        Step = Governor->Steps[--Governor->StepCount];
+        GovernorLog(Governor, "headroom, restore", Step);
+        Result = true;
+    }
+
+    if (Result)
+    {
+        Governor->OverFrames = 0;
+        Governor->UnderFrames = 0;
+        Governor->SettleFrames = GOVERNOR_SETTLE_FRAMES;
+    }
+    return(Result);
+}
+
+internal app_quality
+GovernorQuality(frame_governor *Governor)
+{
+    app_quality Result = {};
+    if (GovernorHasStep(Governor, GovernorStep_CapParticles))
+    {
+        Result.ParticleCap = GOVERNOR_PARTICLE_CAP;
+    }
+    Result.SkipEffects = GovernorHasStep(Governor, GovernorStep_SkipEffects);
+    Result.SkipCollision = (GovernorHasStep(Governor, GovernorStep_SlowCollision) &&
+                            (Governor->FrameIndex & 1));
+    return(Result);
+}
+
+inline u32
+GovernorResolutionShift(frame_governor *Governor)
+{
+    u32 Result = GovernorHasStep(Governor, GovernorStep_HalfResolution) ? 1 : 0;
+    return(Result);
+}
@@ -0,0 +1,308 @@
+#include <math.h>
+
+// NOTE: (Marcus) The mixer runs on its own thread.  The game thread hands
+// it sounds through a single producer / single consumer command ring and
+// the mixer hands finished 16 bit stereo frames to the platform through a
+// second one.  Neither side ever takes a lock or allocates, indices are
+// free running and only ever written by their owner.
+
+#define MIXER_SAMPLES_PER_SECOND 48000
+#define MIXER_CHANNELS 2
+#define MIXER_CHUNK_FRAMES 128
+#define MIXER_MAX_VOICES 32
+
+// NOTE: Size of the output ring and how far ahead of the backend the mixer
+// is allowed to run.  The target is what bounds the latency.
+#define MIXER_OUTPUT_FRAMES 4096
+#define MIXER_TARGET_LATENCY_FRAMES 512
+
+struct audio_command_ring
+{
+    volatile u32 ReadIndex;
+    volatile u32 WriteIndex;
+    audio_play_sound Entries[256];
+};
+
+struct audio_sample_ring
+{
+    volatile u32 ReadFrame;
+    volatile u32 WriteFrame;
+    i16 Samples[MIXER_OUTPUT_FRAMES * MIXER_CHANNELS];
+};
+
+// NOTE: Mono, padded with silence to a multiple of 4 frames so the mix loop
+// never needs a scalar tail.
+struct mixer_sound
+{
+    u32 FrameCount;
+    i16 *Samples;
+};
+
+struct mixer_voice
+{
+    u32 SoundID;
+    u32 StartFrame;
+    u32 Position;
+    float LeftVolume;
+    float RightVolume;
+};
+
+struct audio_mixer
+{
+    mixer_sound Sounds[Sound_Count];
+
+    u32 VoiceCount;
+    mixer_voice Voices[MIXER_MAX_VOICES];
+
+    audio_command_ring Commands;
+    audio_sample_ring Output;
+
+    // NOTE: Written by the backend so the latency includes what it has
+    // already queued on the device.
+    volatile u32 BackendQueuedFrames;
+
+    volatile u32 DroppedCommands;
+    volatile u32 UnderrunFrames;
+    volatile u32 LatencyFrames;
+};
+
+inline u32
+AudioFramesQueued(audio_sample_ring *Ring)
+{
+    u32 Result = Ring->WriteFrame - Ring->ReadFrame;
+    return(Result);
+}
+
+// NOTE: (Marcus) Game thread side.
+internal void
+MixerSubmit(audio_mixer *Mixer, audio_commands *Commands)
+{
+    audio_command_ring *Ring = &Mixer->Commands;
+    u32 WriteIndex = Ring->WriteIndex;
+    for (u32 Index = 0; Index < Commands->Count; ++Index)
+    {
+        if ((WriteIndex - Ring->ReadIndex) >= ArraySize(Ring->Entries))
+        {
+            Mixer->DroppedCommands += (Commands->Count - Index);
+            break;
+        }
+
+        Ring->Entries[WriteIndex % ArraySize(Ring->Entries)] = Commands->Commands[Index];
+        ++WriteIndex;
+    }
+
+    CompletePreviousWritesBeforeFutureWrites;
+    Ring->WriteIndex = WriteIndex;
+    Commands->Count = 0;
+
+    // NOTE: How long a sound submitted now waits to be heard.
+    Mixer->LatencyFrames = AudioFramesQueued(&Mixer->Output) + Mixer->BackendQueuedFrames;
+}
+
+// NOTE: (Marcus) Backend side.  Always fills FrameCount frames, whatever
+// the mixer has not produced yet is silence and counts as an underrun.
+internal void
+MixerReadFrames(audio_mixer *Mixer, i16 *Dest, u32 FrameCount)
+{
+    audio_sample_ring *Ring = &Mixer->Output;
+    u32 ReadFrame = Ring->ReadFrame;
+    u32 Available = Ring->WriteFrame - ReadFrame;
+    CompletePreviousReadsBeforeFutureReads;
+
+    u32 CopyFrames = (Available < FrameCount) ? Available : FrameCount;
+    for (u32 Frame = 0; Frame < CopyFrames; ++Frame)
+    {
+        u32 Source = ((ReadFrame + Frame) % MIXER_OUTPUT_FRAMES) * MIXER_CHANNELS;
+        Dest[Frame*2 + 0] = Ring->Samples[Source + 0];
+        Dest[Frame*2 + 1] = Ring->Samples[Source + 1];
+    }
+    for (u32 Frame = CopyFrames; Frame < FrameCount; ++Frame)
+    {
+        Dest[Frame*2 + 0] = 0;
+        Dest[Frame*2 + 1] = 0;
+    }
+
+    CompletePreviousReadsBeforeFutureReads;
+    Ring->ReadFrame = ReadFrame + CopyFrames;
+    Mixer->UnderrunFrames += (FrameCount - CopyFrames);
+}
+
+internal mixer_sound
+SynthesizeSound(memory_arena *Arena, sound_id SoundID)
+{
+    float Seconds = (SoundID == Sound_Laser) ? 0.15f : 0.4f;
+    mixer_sound Result = {};
+    Result.FrameCount = AlignPow2((u32)(Seconds * MIXER_SAMPLES_PER_SECOND), 4);
+    Result.Samples = PushArray(Arena, Result.FrameCount, i16);
+
+    u32 Noise = 0x12345678;
+    float Phase = 0;
+    for (u32 Frame = 0; Frame < Result.FrameCount; ++Frame)
+    {
+        float t = (float)Frame / (float)Result.FrameCount;
+        float Envelope = (1.0f - t) * (1.0f - t);
+        float Sample = 0;
+        switch (SoundID)
+        {
+            case Sound_Laser:
+            {
+                // NOTE: Square wave sweeping down from 1800Hz to 300Hz.
+                float Frequency = 1800.0f - (1500.0f * t);
+                Phase += Frequency / MIXER_SAMPLES_PER_SECOND;
+                Phase -= (float)(int)Phase;
+                Sample = (Phase < 0.5f) ? 1.0f : -1.0f;
+            } break;
+
+            case Sound_Explosion:
+            {
+                // NOTE: Low passed white noise.
+                Noise = Noise*1664525 + 1013904223;
+                float White = ((float)(Noise >> 16) / 32768.0f) - 1.0f;
+                Phase += 0.15f * (White - Phase);
+                Sample = 2.5f * Phase;
+            } break;
+        }
+
+        Sample = Max(Min(Sample * Envelope, 1.0f), -1.0f);
+        Result.Samples[Frame] = (i16)(Sample * 32767.0f);
+    }
+
+    return(Result);
+}
+
+internal void
+InitializeMixer(audio_mixer *Mixer, memory_arena *Arena)
+{
+    *Mixer = {};
+    for (u32 SoundID = Sound_None + 1; SoundID < Sound_Count; ++SoundID)
+    {
+        Mixer->Sounds[SoundID] = SynthesizeSound(Arena, (sound_id)SoundID);
+    }
+}
+
+internal void
+MixerStartVoices(audio_mixer *Mixer)
+{
+    audio_command_ring *Ring = &Mixer->Commands;
+    u32 WriteIndex = Ring->WriteIndex;
+    CompletePreviousReadsBeforeFutureReads;
+
+    u32 ReadIndex = Ring->ReadIndex;
+    for (; ReadIndex != WriteIndex; ++ReadIndex)
+    {
+        audio_play_sound *Command = &Ring->Entries[ReadIndex % ArraySize(Ring->Entries)];
+        if (Command->SoundID <= Sound_None || Command->SoundID >= Sound_Count) continue;
+
+        // NOTE: When every voice is busy the new sound steals the one that
+        // started longest ago.  MixChunk reorders voices as they finish, so
+        // that is not necessarily the first.
+        u32 WriteFrame = Mixer->Output.WriteFrame;
+        mixer_voice *Voice = 0;
+        if (Mixer->VoiceCount < MIXER_MAX_VOICES)
+        {
+            Voice = &Mixer->Voices[Mixer->VoiceCount++];
+        }
+        else
+        {
+            Voice = &Mixer->Voices[0];
+            for (u32 VoiceIndex = 1; VoiceIndex < Mixer->VoiceCount; ++VoiceIndex)
+            {
+                mixer_voice *Test = &Mixer->Voices[VoiceIndex];
+                if ((WriteFrame - Test->StartFrame) > (WriteFrame - Voice->StartFrame))
+                {
+                    Voice = Test;
+                }
+            }
+        }
+
+        // NOTE: Equal power pan.
+        float Angle = (Command->Pan + 1.0f) * (0.25f * 3.14159265f);
+        Voice->SoundID = Command->SoundID;
+        Voice->StartFrame = WriteFrame;
+        Voice->Position = 0;
+        Voice->LeftVolume = Command->Volume * cosf(Angle);
+        Voice->RightVolume = Command->Volume * sinf(Angle);
+    }
+
+    CompletePreviousReadsBeforeFutureReads;
+    Ring->ReadIndex = ReadIndex;
+}
+
+internal void
+MixChunk(audio_mixer *Mixer, i16 *Dest)
+{
+    __m128 MixLeft[MIXER_CHUNK_FRAMES / 4];
+    __m128 MixRight[MIXER_CHUNK_FRAMES / 4];
+    for (u32 Index = 0; Index < ArraySize(MixLeft); ++Index)
+    {
+        MixLeft[Index] = _mm_setzero_ps();
+        MixRight[Index] = _mm_setzero_ps();
+    }
+
+    for (u32 VoiceIndex = 0; VoiceIndex < Mixer->VoiceCount;)
+    {
+        mixer_voice *Voice = &Mixer->Voices[VoiceIndex];
+        mixer_sound *Sound = &Mixer->Sounds[Voice->SoundID];
+
+        u32 FramesLeft = Sound->FrameCount - Voice->Position;
+        u32 FrameCount = (FramesLeft < MIXER_CHUNK_FRAMES) ? FramesLeft : MIXER_CHUNK_FRAMES;
+
+        __m128 LeftVolume = _mm_set1_ps(Voice->LeftVolume);
+        __m128 RightVolume = _mm_set1_ps(Voice->RightVolume);
+        i16 *Samples = Sound->Samples + Voice->Position;
+        for (u32 Index = 0; Index < (FrameCount / 4); ++Index)
+        {
+            // NOTE: Sign extend 4 i16 to i32 by unpacking into the high
+            // half and shifting back down.
+            __m128i Sample16 = _mm_loadl_epi64((__m128i *)(Samples + 4*Index));
+            __m128i Sample32 = _mm_srai_epi32(_mm_unpacklo_epi16(Sample16, Sample16), 16);
+            __m128 Sample = _mm_cvtepi32_ps(Sample32);
+
+            MixLeft[Index] = _mm_add_ps(MixLeft[Index], _mm_mul_ps(Sample, LeftVolume));
+            MixRight[Index] = _mm_add_ps(MixRight[Index], _mm_mul_ps(Sample, RightVolume));
+        }
+
+        Voice->Position += FrameCount;
+        if (Voice->Position >= Sound->FrameCount)
+        {
+            *Voice = Mixer->Voices[--Mixer->VoiceCount];
+        }
+        else
+        {
+            ++VoiceIndex;
+        }
+    }
+
+    // NOTE: Interleave to L R L R and let packs saturate instead of wrap.
+    for (u32 Index = 0; Index < ArraySize(MixLeft); ++Index)
+    {
+        __m128i Low = _mm_cvtps_epi32(_mm_unpacklo_ps(MixLeft[Index], MixRight[Index]));
+        __m128i High = _mm_cvtps_epi32(_mm_unpackhi_ps(MixLeft[Index], MixRight[Index]));
+        _mm_storeu_si128((__m128i *)(Dest + 8*Index), _mm_packs_epi32(Low, High));
+    }
+}
+
+// NOTE: (Marcus) Mixer thread side.  Returns false when there was nothing
+// to do so the platform can go to sleep.
+internal bool
+MixerUpdate(audio_mixer *Mixer)
+{
+    MixerStartVoices(Mixer);
+
+    bool Result = false;
+    audio_sample_ring *Ring = &Mixer->Output;
+    while ((AudioFramesQueued(Ring) + MIXER_CHUNK_FRAMES) <= MIXER_TARGET_LATENCY_FRAMES)
+    {
+        // NOTE: MIXER_OUTPUT_FRAMES is a multiple of the chunk size so a
+        // chunk never wraps.
+        u32 WriteFrame = Ring->WriteFrame;
+        i16 *Dest = Ring->Samples + (WriteFrame % MIXER_OUTPUT_FRAMES) * MIXER_CHANNELS;
+        MixChunk(Mixer, Dest);
+
+        CompletePreviousWritesBeforeFutureWrites;
+        Ring->WriteFrame = WriteFrame + MIXER_CHUNK_FRAMES;
+        Result = true;
+    }
+
+    return(Result);
+}
@@ -0,0 +1,364 @@
+// NOTE: (Marcus) Lockstep co-op.  Peers never send game state, only the
+// buttons each player held for each tick.  Both sides run the same
+// deterministic simulation on the same inputs at a fixed tick, so the
+// game_states stay identical without ever being compared byte for byte.
+//
+// Local input sampled on tick T is scheduled for tick T + InputDelay, that
+// gives the packet InputDelay ticks to arrive before anyone needs it.  A
+// tick only simulates once every player's input for it is known, if the
+// remote one is late the game stalls rather than guess.
+//
+// Every packet carries all the local inputs the other side has not acked
+// yet, so a lost packet is covered by the next one without any resends.
+// Packet layout, bit packed:
+//   16 Ack        - low bits of how many remote ticks we have
+//   16 FirstTick  - low bits of the first tick of input carried
+//    5 Count      - ticks of input carried
+//    3 * Count    - app_button bits for each tick
+//    1 HasHash
+//   16 HashTick   - only with HasHash
+//   32 Hash       - only with HasHash
+// A LAN game carries 5 to 8 ticks, about 8 bytes a packet at 60 a second.
+
+#define NET_TICK_SECS (1.0f / 60.0f)
+#define NET_INPUT_RING 64
+#define NET_MAX_INPUT_DELAY 8
+#define NET_MAX_TICKS_PER_PACKET 31
+#define NET_HASH_INTERVAL 30
+#define NET_HASH_REPEAT 4
+#define NET_MAX_PACKET_SIZE 32
+
+// NOTE: Both sides must simulate the same screen, it decides where fleets
+// turn around.
+#define NET_SCREEN_WIDTH 1024
+#define NET_SCREEN_HEIGHT 768
+
+struct net_bit_buffer
+{
+    u8 *Base;
+    u32 Size;
+    u32 BitCount;
+    bool Overflowed;
+};
+
+inline net_bit_buffer
+NetBitBuffer(u8 *Base, u32 Size, u32 BitCount = 0)
+{
+    net_bit_buffer Result = {};
+    Result.Base = Base;
+    Result.Size = Size;
+    Result.BitCount = BitCount;
+    return(Result);
+}
+
+internal void
+NetWriteBits(net_bit_buffer *Buffer, u32 Value, u32 Bits)
+{
+    for (u32 Bit = 0; Bit < Bits; ++Bit)
+    {
+        u32 Byte = Buffer->BitCount / 8;
+        if (Byte >= Buffer->Size)
+        {
+            Buffer->Overflowed = true;
+            break;
+        }
+
+        u8 Mask = (u8)(1u << (Buffer->BitCount % 8));
+        if (Value & (1u << Bit))
+        {
+            Buffer->Base[Byte] |= Mask;
+        }
+        else
+        {
+            Buffer->Base[Byte] &= ~Mask;
+        }
+        ++Buffer->BitCount;
+    }
+}
+
+// NOTE: Reading past the end gives zeros and marks the buffer overflowed,
+// callers check once after reading the whole packet.
+internal u32
+NetReadBits(net_bit_buffer *Buffer, u32 Bits)
+{
+    u32 Result = 0;
+    for (u32 Bit = 0; Bit < Bits; ++Bit)
+    {
+        u32 Byte = Buffer->BitCount / 8;
+        if (Byte >= Buffer->Size)
+        {
+            Buffer->Overflowed = true;
+            break;
+        }
+
+        if (Buffer->Base[Byte] & (1u << (Buffer->BitCount % 8)))
+        {
+            Result |= (1u << Bit);
+        }
+        ++Buffer->BitCount;
+    }
+    return(Result);
+}
+
+// NOTE: Only the low 16 bits of a tick go over the wire.  The full tick is
+// whichever one with those bits is closest to a tick we already know.
+inline u32
+NetExpandTick(u32 Reference, u32 Low16)
+{
+    u32 Result = (Reference & 0xFFFF0000) | Low16;
+    if ((i32)(Result - Reference) > 0x8000 && Result >= 0x10000)
+    {
+        Result -= 0x10000;
+    }
+    else if ((i32)(Result - Reference) < -0x8000)
+    {
+        Result += 0x10000;
+    }
+    return(Result);
+}
+
+// NOTE: FNV-1a, only used to notice a desync, not to protect anything.
+internal u32
+NetHashState(void *State, umi Size)
+{
+    u32 Result = 2166136261;
+    u8 *At = (u8 *)State;
+    for (umi Index = 0; Index < Size; ++Index)
+    {
+        Result = (Result ^ At[Index]) * 16777619;
+    }
+    return(Result);
+}
+
+struct lockstep_session
+{
+    u32 LocalPlayer;
+    u32 RemotePlayer;
+    u32 InputDelay;
+
+    // NOTE: Next tick to simulate, and how many ticks of input are known
+    // for each player.  Inputs live in a ring indexed by tick.
+    u32 Tick;
+    u32 KnownTicks[MAX_PLAYERS];
+    u8 Inputs[MAX_PLAYERS][NET_INPUT_RING];
+
+    // NOTE: How many of our ticks the remote has told us it has.
+    u32 RemoteAckedTicks;
+    bool HeardFromRemote;
+
+    // NOTE: Every NET_HASH_INTERVAL ticks the state hash goes out in a few
+    // packets in a row.  The remote one is held until we reach its tick.
+    u32 LocalHashes[NET_INPUT_RING];
+    u32 LocalHashTick;
+    u32 HashSendsLeft;
+    bool HasRemoteHash;
+    u32 RemoteHashTick;
+    u32 RemoteHash;
+    u32 CheckedHashTick;
+
+    u32 StalledFrames;
+    u32 Desyncs;
+    u32 PacketsSent;
+    u32 PacketsReceived;
+    u32 PacketsRejected;
+    u64 BytesSent;
+};
+
+// NOTE: (Marcus) The first InputDelay ticks have no input for anyone, every
+// peer agrees on that without talking.
+internal void
+InitializeLockstep(lockstep_session *Session, u32 LocalPlayer, u32 InputDelay)
+{
+    Assert(LocalPlayer < MAX_PLAYERS);
+    *Session = {};
+    Session->LocalPlayer = LocalPlayer;
+    Session->RemotePlayer = LocalPlayer ^ 1;
+    Session->InputDelay = (InputDelay > NET_MAX_INPUT_DELAY) ? NET_MAX_INPUT_DELAY : InputDelay;
+    Session->CheckedHashTick = 0xFFFFFFFF;
+    for (u32 Player = 0; Player < MAX_PLAYERS; ++Player)
+    {
+        Session->KnownTicks[Player] = Session->InputDelay;
+    }
+    Session->RemoteAckedTicks = Session->InputDelay;
+}
+
+inline u8
+NetButtonsFromKeyboard(app_input *Input)
+{
+    u8 Result = 0;
+    if (KeyIsDown(Input, (u32)'A')) Result |= Button_Left;
+    if (KeyIsDown(Input, (u32)'D')) Result |= Button_Right;
+    if (KeyIsDown(Input, 0x20))     Result |= Button_Fire;
+    return(Result);
+}
+
+// NOTE: (Marcus) Called once a frame.  Queues the local buttons for
+// Tick + InputDelay unless a stall already left them queued, then reports
+// whether Tick can be simulated and with what.
+internal bool
+LockstepAdvance(lockstep_session *Session, u8 LocalButtons, app_input *Input)
+{
+    u32 Local = Session->LocalPlayer;
+    if (Session->KnownTicks[Local] <= (Session->Tick + Session->InputDelay))
+    {
+        u32 Tick = Session->KnownTicks[Local]++;
+        Session->Inputs[Local][Tick % NET_INPUT_RING] = LocalButtons;
+    }
+
+    bool Ready = true;
+    for (u32 Player = 0; Player < MAX_PLAYERS; ++Player)
+    {
+        Ready &= (Session->Tick < Session->KnownTicks[Player]);
+    }
+
+    Input->PlayerCount = MAX_PLAYERS;
+    Input->FrameEllapsedSecs = NET_TICK_SECS;
+    Input->Stalled = !Ready;
+    Input->EventCount = 0;
+    if (Ready)
+    {
+        for (u32 Player = 0; Player < MAX_PLAYERS; ++Player)
+        {
+            Input->PlayerButtons[Player] = Session->Inputs[Player][Session->Tick % NET_INPUT_RING];
+        }
+        ++Session->Tick;
+    }
+    else
+    {
+        ++Session->StalledFrames;
+    }
+
+    return(Ready);
+}
+
+internal void
+LockstepCheckHash(lockstep_session *Session)
+{
+    if (!Session->HasRemoteHash) return;
+
+    u32 Tick = Session->RemoteHashTick;
+    if (Tick < Session->Tick)
+    {
+        if ((Session->Tick - Tick) < NET_INPUT_RING &&
+            Session->LocalHashes[Tick % NET_INPUT_RING] != Session->RemoteHash)
+        {
+            ++Session->Desyncs;
+        }
+        Session->HasRemoteHash = false;
+        Session->CheckedHashTick = Tick;
+    }
+}
+
+// NOTE: Hash of the game_state right after Tick - 1 was simulated.
+internal void
+LockstepRecordHash(lockstep_session *Session, u32 Hash)
+{
+    u32 Tick = Session->Tick - 1;
+    Session->LocalHashes[Tick % NET_INPUT_RING] = Hash;
+    if ((Tick % NET_HASH_INTERVAL) == 0)
+    {
+        Session->LocalHashTick = Tick;
+        Session->HashSendsLeft = NET_HASH_REPEAT;
+    }
+    LockstepCheckHash(Session);
+}
+
+internal u32
+LockstepWritePacket(lockstep_session *Session, u8 *Packet, u32 PacketSize)
+{
+    u32 Local = Session->LocalPlayer;
+    u32 FirstTick = Session->RemoteAckedTicks;
+    u32 Count = Session->KnownTicks[Local] - FirstTick;
+    if (Count > NET_MAX_TICKS_PER_PACKET)
+    {
+        Count = NET_MAX_TICKS_PER_PACKET;
+    }
+
+    net_bit_buffer Buffer = NetBitBuffer(Packet, PacketSize);
+    NetWriteBits(&Buffer, Session->KnownTicks[Session->RemotePlayer] & 0xFFFF, 16);
+    NetWriteBits(&Buffer, FirstTick & 0xFFFF, 16);
+    NetWriteBits(&Buffer, Count, 5);
+    for (u32 Index = 0; Index < Count; ++Index)
+    {
+        u32 Tick = FirstTick + Index;
+        NetWriteBits(&Buffer, Session->Inputs[Local][Tick % NET_INPUT_RING], Button_BitCount);
+    }
+
+    bool HasHash = (Session->HashSendsLeft > 0);
+    NetWriteBits(&Buffer, HasHash, 1);
+    if (HasHash)
+    {
+        NetWriteBits(&Buffer, Session->LocalHashTick & 0xFFFF, 16);
+        NetWriteBits(&Buffer, Session->LocalHashes[Session->LocalHashTick % NET_INPUT_RING], 32);
+    }
+
+    u32 Result = Buffer.Overflowed ? 0 : (Buffer.BitCount + 7) / 8;
+    if (Result)
+    {
+        Session->HashSendsLeft -= HasHash;
+        ++Session->PacketsSent;
+        Session->BytesSent += Result;
+    }
+    return(Result);
+}
+
+internal void
+LockstepReadPacket(lockstep_session *Session, u8 *Packet, u32 PacketSize)
+{
+    u32 Remote = Session->RemotePlayer;
+    net_bit_buffer Buffer = NetBitBuffer(Packet, PacketSize);
+    u32 Ack = NetExpandTick(Session->KnownTicks[Session->LocalPlayer], NetReadBits(&Buffer, 16));
+    u32 FirstTick = NetExpandTick(Session->KnownTicks[Remote], NetReadBits(&Buffer, 16));
+    u32 Count = NetReadBits(&Buffer, 5);
+
+    u8 Buttons[NET_MAX_TICKS_PER_PACKET];
+    for (u32 Index = 0; Index < Count; ++Index)
+    {
+        Buttons[Index] = (u8)NetReadBits(&Buffer, Button_BitCount);
+    }
+
+    bool HasHash = NetReadBits(&Buffer, 1);
+    u32 HashTick = 0;
+    u32 Hash = 0;
+    if (HasHash)
+    {
+        HashTick = NetExpandTick(Session->Tick, NetReadBits(&Buffer, 16));
+        Hash = NetReadBits(&Buffer, 32);
+    }
+
+    // NOTE: Anything that does not line up with what we know is garbage or
+    // from some other session, not something to trust.
+    bool AckIsSane = (Ack <= Session->KnownTicks[Session->LocalPlayer]);
+    bool TicksAreSane = (FirstTick <= Session->KnownTicks[Remote] &&
+                         (FirstTick + Count) <= (Session->Tick + NET_INPUT_RING));
+    if (Buffer.Overflowed || !AckIsSane || !TicksAreSane)
+    {
+        ++Session->PacketsRejected;
+        return;
+    }
+
+    ++Session->PacketsReceived;
+    Session->HeardFromRemote = true;
+    if (Ack > Session->RemoteAckedTicks)
+    {
+        Session->RemoteAckedTicks = Ack;
+    }
+
+    for (u32 Index = 0; Index < Count; ++Index)
+    {
+        u32 Tick = FirstTick + Index;
+        if (Tick == Session->KnownTicks[Remote])
+        {
+            Session->Inputs[Remote][Tick % NET_INPUT_RING] = Buttons[Index];
+            ++Session->KnownTicks[Remote];
+        }
+    }
+
+    if (HasHash && HashTick != Session->CheckedHashTick)
+    {
+        Session->HasRemoteHash = true;
+        Session->RemoteHashTick = HashTick;
+        Session->RemoteHash = Hash;
+        LockstepCheckHash(Session);
+    }
+}
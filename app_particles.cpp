@@ -0,0 +1,133 @@
+// NOTE: (Marcus) Particles are purely cosmetic so they live in transient
+// storage, not game_state, and rewind does not snapshot them.  The pool is
+// structure of arrays so the update runs 4 particles per SSE op, and live
+// particles are always packed at the front so nothing ever walks a free
+// list.  Arrays are padded to a multiple of 4 so the last group can be
+// loaded whole.
+
+#define MAX_PARTICLES (256*1024)
+#define PARTICLE_GRAVITY 400.0f
+
+struct particle_pool
+{
+    u32 Count;
+    u32 Capacity;
+    // NOTE: Bursts stop spawning past Limit, set every frame.
+    u32 Limit;
+    u32 RandomState;
+
+    float *PX;
+    float *PY;
+    float *dPX;
+    float *dPY;
+    float *Life;
+    u32 *Color;
+};
+
+internal void
+InitializeParticles(particle_pool *Pool, memory_arena *Arena, u32 Capacity)
+{
+    *Pool = {};
+    Pool->Capacity = AlignPow2(Capacity, 4);
+    Pool->Limit = Pool->Capacity;
+    Pool->RandomState = 0x2545F491;
+    Pool->PX = PushArray(Arena, Pool->Capacity, float);
+    Pool->PY = PushArray(Arena, Pool->Capacity, float);
+    Pool->dPX = PushArray(Arena, Pool->Capacity, float);
+    Pool->dPY = PushArray(Arena, Pool->Capacity, float);
+    Pool->Life = PushArray(Arena, Pool->Capacity, float);
+    Pool->Color = PushArray(Arena, Pool->Capacity, u32);
+}
+
+inline float
+RandomUnilateral(particle_pool *Pool)
+{
+    // NOTE: xorshift32
+    u32 X = Pool->RandomState;
+    X ^= X << 13;
+    X ^= X >> 17;
+    X ^= X << 5;
+    Pool->RandomState = X;
+
+    float Result = (float)(X >> 8) / (float)(1 << 24);
+    return(Result);
+}
+
+internal void
+SpawnParticleBurst(particle_pool *Pool, v2 P, u32 Count, u32 Color, float Speed)
+{
+    u32 Limit = (Pool->Limit < Pool->Capacity) ? Pool->Limit : Pool->Capacity;
+    u32 Free = (Pool->Count < Limit) ? (Limit - Pool->Count) : 0;
+    Count = (Count < Free) ? Count : Free;
+    for (u32 Index = Pool->Count; Index < (Pool->Count + Count); ++Index)
+    {
+        float X = (2.0f * RandomUnilateral(Pool)) - 1.0f;
+        float Y = (2.0f * RandomUnilateral(Pool)) - 1.0f;
+        float Scale = Speed * RandomUnilateral(Pool);
+
+        Pool->PX[Index] = P.X;
+        Pool->PY[Index] = P.Y;
+        Pool->dPX[Index] = X * Scale;
+        Pool->dPY[Index] = Y * Scale;
+        Pool->Life[Index] = 0.5f + RandomUnilateral(Pool);
+        Pool->Color[Index] = Color;
+    }
+    Pool->Count += Count;
+}
+
+internal void
+UpdateParticles(particle_pool *Pool, float dt)
+{
+    __m128 dtWide = _mm_set1_ps(dt);
+    __m128 GravityWide = _mm_set1_ps(PARTICLE_GRAVITY * dt);
+    __m128 Zero = _mm_setzero_ps();
+
+    u32 Write = 0;
+    for (u32 Read = 0; Read < Pool->Count; Read += 4)
+    {
+        __m128 dPX = _mm_loadu_ps(Pool->dPX + Read);
+        __m128 dPY = _mm_add_ps(_mm_loadu_ps(Pool->dPY + Read), GravityWide);
+        __m128 PX = _mm_add_ps(_mm_loadu_ps(Pool->PX + Read), _mm_mul_ps(dPX, dtWide));
+        __m128 PY = _mm_add_ps(_mm_loadu_ps(Pool->PY + Read), _mm_mul_ps(dPY, dtWide));
+        __m128 Life = _mm_sub_ps(_mm_loadu_ps(Pool->Life + Read), dtWide);
+
+        u32 LaneCount = Pool->Count - Read;
+        u32 ValidMask = (LaneCount >= 4) ? 0xF : ((1 << LaneCount) - 1);
+        u32 AliveMask = _mm_movemask_ps(_mm_cmpgt_ps(Life, Zero)) & ValidMask;
+
+        if (AliveMask == 0xF && Write == Read)
+        {
+            // NOTE: Nothing has died yet, update in place.
+            _mm_storeu_ps(Pool->dPY + Write, dPY);
+            _mm_storeu_ps(Pool->PX + Write, PX);
+            _mm_storeu_ps(Pool->PY + Write, PY);
+            _mm_storeu_ps(Pool->Life + Write, Life);
+            Write += 4;
+        }
+        else if (AliveMask)
+        {
+            // NOTE: Pack the survivors down over the dead.  Write never
+            // passes Read so nothing unread gets stomped.
+            float Lanes[5][4];
+            _mm_storeu_ps(Lanes[0], PX);
+            _mm_storeu_ps(Lanes[1], PY);
+            _mm_storeu_ps(Lanes[2], dPX);
+            _mm_storeu_ps(Lanes[3], dPY);
+            _mm_storeu_ps(Lanes[4], Life);
+            for (u32 Lane = 0; Lane < 4; ++Lane)
+            {
+                if (!(AliveMask & (1 << Lane))) continue;
+
+                Pool->PX[Write] = Lanes[0][Lane];
+                Pool->PY[Write] = Lanes[1][Lane];
+                Pool->dPX[Write] = Lanes[2][Lane];
+                Pool->dPY[Write] = Lanes[3][Lane];
+                Pool->Life[Write] = Lanes[4][Lane];
+                Pool->Color[Write] = Pool->Color[Read + Lane];
+                ++Write;
+            }
+        }
+    }
+
+    Pool->Count = Write;
+}
@@ -0,0 +1,355 @@
+// NOTE: (Marcus) Software rasterizer.  Each kernel is written once as a
+// template over the things that would otherwise be checked per pixel:
+//
+//   format - what a pixel is, 32 bit BGRA or 8 bit gray
+//   Blend  - opaque store or saturating add
+//   Clip   - whether the shape can hang off the target at all
+//   Span   - narrow spans are a plain loop, wide ones go a register at a time
+//
+// The decoder works out per command which of those apply and calls that
+// instantiation, so inside a kernel every branch is on a constant.  A
+// missile is an unclipped opaque narrow rectangle, the clear is an
+// unclipped opaque wide one.
+
+enum render_blend
+{
+    Blend_Opaque,
+    Blend_Additive
+};
+
+enum render_span
+{
+    Span_Narrow,
+    Span_Wide
+};
+
+// NOTE: Anything narrower than a couple of registers is not worth the SIMD
+// setup and tail.
+#define RENDER_NARROW_SPAN 8
+
+// NOTE: (Marcus) Commands are always in screen space.  A target with a
+// ResolutionShift is that many halvings smaller, the decoder scales the
+// commands down to it.
+struct render_target
+{
+    void *Memory;
+    u32 Width;
+    u32 Height;
+    u32 Pitch;
+    u32 ResolutionShift;
+
+    // NOTE: Every pixel written, counted per shape after clipping.
+    u64 PixelsFilled;
+};
+
+struct pixel_bgra32
+{
+    typedef u32 pixel;
+    enum { PixelsPerWide = 4 };
+
+    static inline pixel FromColor(u32 Color)
+    {
+        return(Color);
+    }
+
+    static inline __m128i Wide(pixel Value)
+    {
+        return(_mm_set1_epi32((int)Value));
+    }
+};
+
+struct pixel_gray8
+{
+    typedef u8 pixel;
+    enum { PixelsPerWide = 16 };
+
+    // NOTE: Rec. 601 luma, the weights add up to 256.
+    static inline pixel FromColor(u32 Color)
+    {
+        u32 R = (Color >> 16) & 0xFF;
+        u32 G = (Color >> 8) & 0xFF;
+        u32 B = Color & 0xFF;
+        return((pixel)(((R * 77) + (G * 150) + (B * 29)) >> 8));
+    }
+
+    static inline __m128i Wide(pixel Value)
+    {
+        return(_mm_set1_epi8((char)Value));
+    }
+};
+
+template<render_blend Blend>
+inline void
+BlendPixel(u32 *Dest, u32 Color)
+{
+    if (Blend == Blend_Opaque)
+    {
+        *Dest = Color;
+    }
+    else
+    {
+        __m128i Pixel = _mm_cvtsi32_si128((int)*Dest);
+        *Dest = (u32)_mm_cvtsi128_si32(_mm_adds_epu8(Pixel, _mm_cvtsi32_si128((int)Color)));
+    }
+}
+
+template<render_blend Blend>
+inline void
+BlendPixel(u8 *Dest, u8 Color)
+{
+    if (Blend == Blend_Opaque)
+    {
+        *Dest = Color;
+    }
+    else
+    {
+        u32 Sum = (u32)*Dest + (u32)Color;
+        *Dest = (u8)((Sum > 255) ? 255 : Sum);
+    }
+}
+
+// NOTE: Both formats saturate per byte, so one register op covers either.
+template<render_blend Blend>
+inline void
+BlendWide(void *Dest, __m128i Color)
+{
+    if (Blend == Blend_Opaque)
+    {
+        _mm_storeu_si128((__m128i *)Dest, Color);
+    }
+    else
+    {
+        __m128i Pixels = _mm_loadu_si128((__m128i *)Dest);
+        _mm_storeu_si128((__m128i *)Dest, _mm_adds_epu8(Pixels, Color));
+    }
+}
+
+// NOTE: Shift steps through the source that many halvings faster.
+template<u32 Shift>
+inline void
+CopySpan(u32 *Dest, u32 *Source, u32 Count)
+{
+    if (Shift == 0)
+    {
+        memcpy(Dest, Source, Count * sizeof(u32));
+    }
+    else
+    {
+        for (u32 Index = 0; Index < Count; ++Index)
+        {
+            Dest[Index] = Source[Index << Shift];
+        }
+    }
+}
+
+template<u32 Shift>
+inline void
+CopySpan(u8 *Dest, u32 *Source, u32 Count)
+{
+    for (u32 Index = 0; Index < Count; ++Index)
+    {
+        Dest[Index] = pixel_gray8::FromColor(Source[Index << Shift]);
+    }
+}
+
+// NOTE: Clamps to the target, false when nothing is left.
+inline bool
+ClipToTarget(render_target *Target, i32 *X, i32 *Y, i32 *Width, i32 *Height)
+{
+    i32 MinX = (*X < 0) ? 0 : *X;
+    i32 MinY = (*Y < 0) ? 0 : *Y;
+    i32 MaxX = *X + *Width;
+    i32 MaxY = *Y + *Height;
+    MaxX = (MaxX > (i32)Target->Width) ? (i32)Target->Width : MaxX;
+    MaxY = (MaxY > (i32)Target->Height) ? (i32)Target->Height : MaxY;
+
+    *X = MinX;
+    *Y = MinY;
+    *Width = MaxX - MinX;
+    *Height = MaxY - MinY;
+    bool Result = (*Width > 0 && *Height > 0);
+    return(Result);
+}
+
+inline bool
+IsInsideTarget(render_target *Target, i32 X, i32 Y, i32 Width, i32 Height)
+{
+    bool Result = (X >= 0 && Y >= 0 &&
+                   (X + Width) <= (i32)Target->Width &&
+                   (Y + Height) <= (i32)Target->Height);
+    return(Result);
+}
+
+template<typename format, render_blend Blend, bool Clip, render_span Span>
+internal void
+FillRectangle(render_target *Target, i32 X, i32 Y, i32 Width, i32 Height, u32 Color)
+{
+    typedef typename format::pixel pixel;
+    if (Clip && !ClipToTarget(Target, &X, &Y, &Width, &Height)) return;
+    Target->PixelsFilled += (u64)(Width * Height);
+
+    pixel Value = format::FromColor(Color);
+    __m128i WideValue = format::Wide(Value);
+    pixel *Row = (pixel *)Target->Memory + (Y * Target->Pitch) + X;
+    for (i32 RowIndex = 0; RowIndex < Height; ++RowIndex)
+    {
+        i32 Index = 0;
+        if (Span == Span_Wide)
+        {
+            for (; (Index + format::PixelsPerWide) <= Width; Index += format::PixelsPerWide)
+            {
+                BlendWide<Blend>(Row + Index, WideValue);
+            }
+        }
+        for (; Index < Width; ++Index)
+        {
+            BlendPixel<Blend>(Row + Index, Value);
+        }
+        Row += Target->Pitch;
+    }
+}
+
+// NOTE: (Marcus) Picks the kernel for one rectangle.
+template<typename format, render_blend Blend>
+internal void
+DrawRectangle(render_target *Target, i32 X, i32 Y, i32 Width, i32 Height, u32 Color)
+{
+    bool Inside = IsInsideTarget(Target, X, Y, Width, Height);
+    bool Narrow = (Width <= RENDER_NARROW_SPAN);
+    if (Inside && Narrow)
+        FillRectangle<format, Blend, false, Span_Narrow>(Target, X, Y, Width, Height, Color);
+    else if (Inside)
+        FillRectangle<format, Blend, false, Span_Wide>(Target, X, Y, Width, Height, Color);
+    else if (Narrow)
+        FillRectangle<format, Blend, true, Span_Narrow>(Target, X, Y, Width, Height, Color);
+    else
+        FillRectangle<format, Blend, true, Span_Wide>(Target, X, Y, Width, Height, Color);
+}
+
+// NOTE: Nearest sampled when Shift is not 0.
+template<typename format, bool Clip, u32 Shift>
+internal void
+BlitBitmap(render_target *Target, render_bitmap *Bitmap)
+{
+    typedef typename format::pixel pixel;
+    i32 BitmapX = Bitmap->X >> Shift;
+    i32 BitmapY = Bitmap->Y >> Shift;
+    i32 X = BitmapX;
+    i32 Y = BitmapY;
+    i32 Width = (i32)(Bitmap->Width >> Shift);
+    i32 Height = (i32)(Bitmap->Height >> Shift);
+    if (Clip && !ClipToTarget(Target, &X, &Y, &Width, &Height)) return;
+    Target->PixelsFilled += (u64)(Width * Height);
+
+    u32 *Source = Bitmap->Pixels + ((Y - BitmapY) << Shift)*Bitmap->Pitch + ((X - BitmapX) << Shift);
+    pixel *Dest = (pixel *)Target->Memory + (Y * Target->Pitch) + X;
+    for (i32 Row = 0; Row < Height; ++Row)
+    {
+        CopySpan<Shift>(Dest, Source, (u32)Width);
+        Source += (Bitmap->Pitch << Shift);
+        Dest += Target->Pitch;
+    }
+}
+
+// NOTE: (Marcus) Additive, so overlapping particles glow.  Size is a
+// constant so each particle is a fixed little block with no loop setup.
+template<typename format, u32 Size>
+internal void
+DrawParticles(render_target *Target, render_particle_batch *Batch)
+{
+    typedef typename format::pixel pixel;
+    __m128i Zero = _mm_setzero_si128();
+    float Scale = 1.0f / (float)(1 << Target->ResolutionShift);
+    float MaxX = (float)(Target->Width - Size);
+    float MaxY = (float)(Target->Height - Size);
+    u32 Drawn = 0;
+    for (u32 Particle = 0; Particle < Batch->Count; ++Particle)
+    {
+        float X = Scale * Batch->X[Particle];
+        float Y = Scale * Batch->Y[Particle];
+        if (X < 0 || Y < 0 || X > MaxX || Y > MaxY) continue;
+        ++Drawn;
+
+        // NOTE: Fade out over the last half second of life.
+        float Fade = Min(2.0f * Batch->Life[Particle], 1.0f);
+        __m128i Color = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)Batch->Color[Particle]), Zero);
+        Color = _mm_srli_epi16(_mm_mullo_epi16(Color, _mm_set1_epi16((i16)(Fade * 256.0f))), 8);
+        pixel Value = format::FromColor((u32)_mm_cvtsi128_si32(_mm_packus_epi16(Color, Color)));
+
+        pixel *Row = (pixel *)Target->Memory + ((u32)Y * Target->Pitch) + (u32)X;
+        for (u32 RowIndex = 0; RowIndex < Size; ++RowIndex)
+        {
+            for (u32 Index = 0; Index < Size; ++Index)
+            {
+                BlendPixel<Blend_Additive>(Row + Index, Value);
+            }
+            Row += Target->Pitch;
+        }
+    }
+    Target->PixelsFilled += (u64)Drawn * Size * Size;
+}
+
+template<typename format>
+internal void
+RenderToTarget(render_commands *RenderCommands, render_target *Target)
+{
+    u32 Shift = Target->ResolutionShift;
+    Assert(Shift <= 1);
+
+    void *BufferEntry = RenderCommands->PushBuffer;
+    for (umi Index = 0;
+         Index < RenderCommands->PushBufferEntryCount;
+         ++Index)
+    {
+        render_command_header *Header = (render_command_header *)BufferEntry;
+        void *Data = (u8 *)Header + sizeof(render_command_header);
+        switch (Header->Type)
+        {
+            case RenderCommand_Rectangle:
+            {
+                render_rectangle *Command = (render_rectangle *)Data;
+                // NOTE: Round the far edges up so thin things never vanish.
+                i32 X = Command->X >> Shift;
+                i32 Y = Command->Y >> Shift;
+                i32 Width = ((Command->X + (i32)Command->Width + (1 << Shift) - 1) >> Shift) - X;
+                i32 Height = ((Command->Y + (i32)Command->Height + (1 << Shift) - 1) >> Shift) - Y;
+                DrawRectangle<format, Blend_Opaque>(Target, X, Y, Width, Height, Command->Color);
+            } break;
+
+            case RenderCommand_ParticleBatch:
+            {
+                render_particle_batch *Command = (render_particle_batch *)Data;
+                Assert(Command->Size == 1 || Command->Size == 2);
+                if ((Command->Size >> Shift) == 2)
+                    DrawParticles<format, 2>(Target, Command);
+                else
+                    DrawParticles<format, 1>(Target, Command);
+            } break;
+
+            case RenderCommand_Bitmap:
+            {
+                render_bitmap *Command = (render_bitmap *)Data;
+                bool Inside = IsInsideTarget(Target, Command->X >> Shift, Command->Y >> Shift,
+                                             (i32)(Command->Width >> Shift),
+                                             (i32)(Command->Height >> Shift));
+                if (Inside && Shift)
+                    BlitBitmap<format, false, 1>(Target, Command);
+                else if (Shift)
+                    BlitBitmap<format, true, 1>(Target, Command);
+                else if (Inside)
+                    BlitBitmap<format, false, 0>(Target, Command);
+                else
+                    BlitBitmap<format, true, 0>(Target, Command);
+            } break;
+
+            case RenderCommand_Clear:
+            {
+                render_clear_color *Command = (render_clear_color *)Data;
+                FillRectangle<format, Blend_Opaque, false, Span_Wide>(
+                    Target, 0, 0, (i32)Target->Width, (i32)Target->Height, Command->Color);
+            } break;
+        }
+
+        BufferEntry = (u8 *)BufferEntry + Header->Size;
+    }
+}
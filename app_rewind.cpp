@@ -0,0 +1,278 @@
+// NOTE: (Marcus) Rewind keeps the last few seconds of game_state history.
+// Every REWIND_KEYFRAME_INTERVAL frames a full copy of the state is stored.
+// The frames in between only store the XOR of the state against that
+// keyframe, run length encoded, so bytes that did not change cost nothing.
+// Restoring any frame is one keyframe copy plus one delta decode.
+//
+// Delta encoding is a list of runs:
+//   u16 Skip   - unchanged bytes to step over
+//   u16 Count  - changed bytes that follow
+//   u8  Xor[Count]
+
+#define REWIND_SECONDS 5
+#define REWIND_MAX_FRAMES (REWIND_SECONDS*60)
+#define REWIND_KEYFRAME_INTERVAL 30
+
+struct rewind_frame
+{
+    umi Offset;
+    umi Size;
+    u32 KeyframeSlot;
+    bool IsKeyframe;
+};
+
+struct rewind_buffer
+{
+    umi SnapshotSize;
+    u8 *Scratch;
+
+    umi DataSize;
+    umi WriteOffset;
+    umi BytesInUse;
+    u8 *Data;
+
+    u32 FirstFrame;
+    u32 FrameCount;
+    rewind_frame Frames[REWIND_MAX_FRAMES];
+
+    bool KeyframeIsValid;
+    u32 KeyframeSlot;
+    u32 FramesSinceKeyframe;
+};
+
+internal void
+InitializeRewind(rewind_buffer *Rewind, memory_arena *Arena, umi SnapshotSize)
+{
+    *Rewind = {};
+    Rewind->SnapshotSize = SnapshotSize;
+
+    Rewind->Scratch = PushArray(Arena, SnapshotSize, u8);
+
+    // NOTE: Enough for all the keyframes in the window plus deltas that
+    // average a quarter of the state.  If the deltas are bigger than that
+    // the oldest frames fall off early, memory never grows.
+    u32 KeyframeCount = (REWIND_MAX_FRAMES / REWIND_KEYFRAME_INTERVAL) + 2;
+    Rewind->DataSize = SnapshotSize * (KeyframeCount + (REWIND_MAX_FRAMES / 4));
+    Rewind->Data = PushArray(Arena, Rewind->DataSize, u8);
+}
+
+inline u32
+RewindSlot(rewind_buffer *Rewind, u32 Index)
+{
+    u32 Result = (Rewind->FirstFrame + Index) % REWIND_MAX_FRAMES;
+    return(Result);
+}
+
+internal void
+RewindDropOldest(rewind_buffer *Rewind)
+{
+    Assert(Rewind->FrameCount > 0);
+    rewind_frame *Oldest = &Rewind->Frames[Rewind->FirstFrame];
+    if (Oldest->IsKeyframe && Rewind->KeyframeSlot == Rewind->FirstFrame)
+    {
+        Rewind->KeyframeIsValid = false;
+    }
+
+    Rewind->BytesInUse -= Oldest->Size;
+    Rewind->FirstFrame = (Rewind->FirstFrame + 1) % REWIND_MAX_FRAMES;
+    --Rewind->FrameCount;
+}
+
+internal u8 *
+RewindAllocate(rewind_buffer *Rewind, umi Size)
+{
+    Assert(Size <= Rewind->DataSize);
+    if ((Rewind->WriteOffset + Size) > Rewind->DataSize)
+    {
+        Rewind->WriteOffset = 0;
+    }
+
+    umi Start = Rewind->WriteOffset;
+    umi End = Start + Size;
+
+    // NOTE: Frames are written in order, so the ones we are about to
+    // overwrite are always the oldest.  Deltas without their keyframe are
+    // useless so those go too.
+    while (Rewind->FrameCount)
+    {
+        rewind_frame *Oldest = &Rewind->Frames[Rewind->FirstFrame];
+        bool Overlaps = Size && (Oldest->Offset < End) && (Start < (Oldest->Offset + Oldest->Size));
+        bool Orphaned = !Oldest->IsKeyframe;
+        bool SlotsFull = (Rewind->FrameCount == REWIND_MAX_FRAMES);
+        if (!(Overlaps || Orphaned || SlotsFull)) break;
+
+        RewindDropOldest(Rewind);
+    }
+
+    u8 *Result = Rewind->Data + Start;
+    Rewind->WriteOffset = End;
+    return(Result);
+}
+
+// NOTE: False when the delta would not fit in DestSize.  An unchanged
+// state is a delta of 0 bytes.
+internal bool
+RewindEncodeDelta(u8 *Current, u8 *Keyframe, umi Size, u8 *Dest, umi DestSize, umi *DeltaSize)
+{
+    umi Written = 0;
+    umi At = 0;
+    while (At < Size)
+    {
+        umi Skip = 0;
+        while ((At + Skip) < Size && Skip < 0xFFFF &&
+               Current[At + Skip] == Keyframe[At + Skip])
+        {
+            ++Skip;
+        }
+        At += Skip;
+
+        // NOTE: A run of changed bytes ends at 4 unchanged bytes, anything
+        // shorter is cheaper to carry along than a new run header.
+        umi Count = 0;
+        umi Unchanged = 0;
+        while ((At + Count) < Size && Count < 0xFFFF && Unchanged < 4)
+        {
+            Unchanged = (Current[At + Count] == Keyframe[At + Count]) ? Unchanged + 1 : 0;
+            ++Count;
+        }
+        Count -= Unchanged;
+
+        if (Count == 0 && At >= Size) break;
+        if ((Written + 4 + Count) > DestSize) return(false);
+
+        u16 *Header = (u16 *)(Dest + Written);
+        Header[0] = (u16)Skip;
+        Header[1] = (u16)Count;
+        Written += 4;
+
+        for (umi Index = 0; Index < Count; ++Index)
+        {
+            Dest[Written + Index] = Current[At + Index] ^ Keyframe[At + Index];
+        }
+        Written += Count;
+        At += Count;
+    }
+
+    *DeltaSize = Written;
+    return(true);
+}
+
+internal void
+RewindDecodeDelta(u8 *Delta, umi DeltaSize, u8 *Dest)
+{
+    u8 *At = Delta;
+    u8 *End = Delta + DeltaSize;
+    umi Offset = 0;
+    while (At < End)
+    {
+        u16 *Header = (u16 *)At;
+        u16 Skip = Header[0];
+        u16 Count = Header[1];
+        At += 4;
+        Offset += Skip;
+
+        for (u32 Index = 0; Index < Count; ++Index)
+        {
+            Dest[Offset + Index] ^= At[Index];
+        }
+        Offset += Count;
+        At += Count;
+    }
+}
+
+internal void
+RewindSnapshot(rewind_buffer *Rewind, void *State)
+{
+    umi Size = Rewind->SnapshotSize;
+    umi DeltaSize = 0;
+
+    bool WantKeyframe = (!Rewind->KeyframeIsValid ||
+                         Rewind->FramesSinceKeyframe >= REWIND_KEYFRAME_INTERVAL);
+    if (!WantKeyframe)
+    {
+        rewind_frame *Keyframe = &Rewind->Frames[Rewind->KeyframeSlot];
+        // NOTE: A delta as big as the state is not worth keeping.
+        WantKeyframe = !RewindEncodeDelta((u8 *)State, Rewind->Data + Keyframe->Offset, Size,
+                                          Rewind->Scratch, Size, &DeltaSize);
+    }
+
+    if (!WantKeyframe)
+    {
+        u8 *Dest = RewindAllocate(Rewind, DeltaSize);
+        // NOTE: Making room may have pushed our keyframe out.
+        WantKeyframe = !Rewind->KeyframeIsValid;
+        if (!WantKeyframe)
+        {
+            memcpy(Dest, Rewind->Scratch, DeltaSize);
+
+            u32 Slot = RewindSlot(Rewind, Rewind->FrameCount++);
+            rewind_frame *Frame = &Rewind->Frames[Slot];
+            Frame->Offset = Dest - Rewind->Data;
+            Frame->Size = DeltaSize;
+            Frame->KeyframeSlot = Rewind->KeyframeSlot;
+            Frame->IsKeyframe = false;
+
+            Rewind->BytesInUse += DeltaSize;
+            ++Rewind->FramesSinceKeyframe;
+        }
+        else
+        {
+            Rewind->WriteOffset = Dest - Rewind->Data;
+        }
+    }
+
+    if (WantKeyframe)
+    {
+        u8 *Dest = RewindAllocate(Rewind, Size);
+        memcpy(Dest, State, Size);
+
+        u32 Slot = RewindSlot(Rewind, Rewind->FrameCount++);
+        rewind_frame *Frame = &Rewind->Frames[Slot];
+        Frame->Offset = Dest - Rewind->Data;
+        Frame->Size = Size;
+        Frame->KeyframeSlot = Slot;
+        Frame->IsKeyframe = true;
+
+        Rewind->BytesInUse += Size;
+        Rewind->KeyframeIsValid = true;
+        Rewind->KeyframeSlot = Slot;
+        Rewind->FramesSinceKeyframe = 1;
+    }
+}
+
+internal void
+RewindRestore(rewind_buffer *Rewind, u32 FramesBack, void *State)
+{
+    Assert(FramesBack < Rewind->FrameCount);
+    u32 Slot = RewindSlot(Rewind, Rewind->FrameCount - 1 - FramesBack);
+    rewind_frame *Frame = &Rewind->Frames[Slot];
+    rewind_frame *Keyframe = &Rewind->Frames[Frame->KeyframeSlot];
+
+    memcpy(State, Rewind->Data + Keyframe->Offset, Rewind->SnapshotSize);
+    if (!Frame->IsKeyframe)
+    {
+        RewindDecodeDelta(Rewind->Data + Frame->Offset, Frame->Size, (u8 *)State);
+    }
+}
+
+// NOTE: Throws away the newest frame and restores the one before it.  The
+// frame after a rewind is always stored as a keyframe so the history we
+// branch from never gets a delta against a frame that was thrown away.
+internal bool
+RewindStepBack(rewind_buffer *Rewind, void *State)
+{
+    bool Result = false;
+    if (Rewind->FrameCount > 1)
+    {
+        u32 Slot = RewindSlot(Rewind, Rewind->FrameCount - 1);
+        rewind_frame *Newest = &Rewind->Frames[Slot];
+        Rewind->BytesInUse -= Newest->Size;
+        Rewind->WriteOffset = Newest->Offset;
+        --Rewind->FrameCount;
+
+        Rewind->KeyframeIsValid = false;
+        RewindRestore(Rewind, 0, State);
+        Result = true;
+    }
+    return(Result);
+}
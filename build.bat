@@ -2,5 +2,8 @@
 
 if not exist .\build mkdir build
 pushd build
-cl -Od -Oi -Z7 ../win32_nsi.cpp /link user32.lib gdi32.lib winmm.lib
+cl -Od -Oi -Z7 ../win32_nsi.cpp /link user32.lib gdi32.lib winmm.lib advapi32.lib ws2_32.lib
+cl -O2 -Oi -Z7 -LD ../win32_nsi_batch.cpp
+cl -O2 -Oi -Z7 ../win32_nsi_counters.cpp /link user32.lib
+cl -O2 -Oi -Z7 ../nsi_netsoak.cpp
 popd
@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "app.cpp"
+#include "app_net.cpp"
+
+// NOTE: (Marcus) Headless soak test for lockstep co-op, see app_net.cpp.
+// Two peers run the whole game in one process, each with its own memory,
+// and talk over a simulated link that drops and delays packets.  There
+// are no sockets and the randomness is seeded, so a run is repeatable.
+//
+// It sweeps packet loss and delay and fails if any run reports a desync,
+// then nudges one peer's state part way through a run and fails if the
+// state hashes do not catch it.  Exits 0 when everything passed.
+
+#define SOAK_FRAMES 3600
+#define SOAK_INPUT_DELAY 3
+#define SOAK_MAX_PACKETS 256
+#define SOAK_CORRUPT_FRAME 1000
+
+struct soak_packet
+{
+    u32 DeliverFrame;
+    u32 Size;
+    u8 Data[NET_MAX_PACKET_SIZE];
+};
+
+// NOTE: Packets one way, in no particular order.  Delivery jitters by a
+// couple of frames, so they arrive out of order too.
+struct soak_link
+{
+    u32 Count;
+    soak_packet Packets[SOAK_MAX_PACKETS];
+};
+
+struct soak_peer
+{
+    app_memory Memory;
+    void *PushBuffer;
+    umi PushBufferSize;
+    lockstep_session Session;
+};
+
+global u32 SoakRandomState;
+
+inline u32
+SoakRandom()
+{
+    u32 X = SoakRandomState;
+    X ^= X << 13;
+    X ^= X >> 17;
+    X ^= X << 5;
+    SoakRandomState = X;
+    return(X);
+}
+
+internal PLATFORM_COMMIT_MEMORY(SoakCommitMemory)
+{
+    return(true);
+}
+
+internal void
+SoakSend(soak_link *Link, u32 Frame, u8 *Data, u32 Size, u32 LossPercent, u32 DelayFrames)
+{
+    if ((SoakRandom() % 100) < LossPercent) return;
+    Assert(Link->Count < SOAK_MAX_PACKETS);
+
+    soak_packet *Packet = &Link->Packets[Link->Count++];
+    Packet->DeliverFrame = Frame + DelayFrames + (SoakRandom() % 3);
+    Packet->Size = Size;
+    memcpy(Packet->Data, Data, Size);
+}
+
+internal void
+SoakDeliver(soak_link *Link, u32 Frame, lockstep_session *Session)
+{
+    for (u32 Index = 0; Index < Link->Count;)
+    {
+        soak_packet *Packet = &Link->Packets[Index];
+        if (Packet->DeliverFrame <= Frame)
+        {
+            LockstepReadPacket(Session, Packet->Data, Packet->Size);
+            *Packet = Link->Packets[--Link->Count];
+        }
+        else
+        {
+            ++Index;
+        }
+    }
+}
+
+internal void
+SoakStartPeer(soak_peer *Peer, u32 LocalPlayer)
+{
+    umi TransientSize = Megabytes(64);
+    memset(Peer->Memory.PerminantStorage, 0, Peer->Memory.PerminantStorageSize);
+    memset(Peer->Memory.TransientStorage, 0, TransientSize);
+    Peer->Memory.TransientStorageSize = TransientSize;
+    Peer->Memory.TransientStorageCommitted = TransientSize;
+    Peer->Memory.PerminantStorageCommitted = Peer->Memory.PerminantStorageSize;
+    Peer->Memory.CommitMemory = SoakCommitMemory;
+    InitializeLockstep(&Peer->Session, LocalPlayer, SOAK_INPUT_DELAY);
+}
+
+// NOTE: The same steps as Win32NetBeginFrame and Win32NetEndFrame.
+internal void
+SoakStepPeer(soak_peer *Peer, u8 Buttons)
+{
+    app_input Input = {};
+    LockstepAdvance(&Peer->Session, Buttons, &Input);
+    Input.ScreenWidth = NET_SCREEN_WIDTH;
+    Input.ScreenHeight = NET_SCREEN_HEIGHT;
+
+    render_commands RenderCommands = CreateRenderCommands(
+        Peer->PushBufferSize, Peer->PushBuffer, Peer->PushBufferSize, SoakCommitMemory);
+    audio_commands AudioCommands = {};
+    GameUpdateAndRender(Input, &Peer->Memory, &RenderCommands, &AudioCommands);
+
+    if (!Input.Stalled)
+    {
+        LockstepRecordHash(&Peer->Session, NetHashState(Peer->Memory.PerminantStorage, sizeof(game_state)));
+    }
+}
+
+// NOTE: (Marcus) Each peer holds a random set of buttons for a third of a
+// second at a time, like the -netloopback game.
+internal void
+RunSoak(soak_peer *Peers, u32 LossPercent, u32 DelayFrames, bool Corrupt)
+{
+    static soak_link Links[2];
+    Links[0].Count = 0;
+    Links[1].Count = 0;
+    SoakRandomState = 0x9E3779B9 ^ (LossPercent * 977) ^ (DelayFrames * 131);
+    SoakStartPeer(&Peers[0], 0);
+    SoakStartPeer(&Peers[1], 1);
+
+    u8 Buttons[2] = {};
+    for (u32 Frame = 0; Frame < SOAK_FRAMES; ++Frame)
+    {
+        if (Corrupt && Frame == SOAK_CORRUPT_FRAME)
+        {
+            game_state *GameState = (game_state *)Peers[1].Memory.PerminantStorage;
+            GameState->Players[0].P.X += 1.0f;
+        }
+
+        for (u32 PeerIndex = 0; PeerIndex < 2; ++PeerIndex)
+        {
+            soak_peer *Peer = &Peers[PeerIndex];
+            SoakDeliver(&Links[PeerIndex ^ 1], Frame, &Peer->Session);
+
+            if ((Frame % 20) == 0)
+            {
+                Buttons[PeerIndex] = (u8)(SoakRandom() & ((1 << Button_BitCount) - 1));
+            }
+            SoakStepPeer(Peer, Buttons[PeerIndex]);
+
+            u8 Packet[NET_MAX_PACKET_SIZE];
+            u32 Size = LockstepWritePacket(&Peer->Session, Packet, sizeof(Packet));
+            if (Size)
+            {
+                SoakSend(&Links[PeerIndex], Frame, Packet, Size, LossPercent, DelayFrames);
+            }
+        }
+    }
+}
+
+int
+main()
+{
+    soak_peer Peers[2] = {};
+    for (u32 PeerIndex = 0; PeerIndex < 2; ++PeerIndex)
+    {
+        soak_peer *Peer = &Peers[PeerIndex];
+        Peer->Memory.PerminantStorageSize = Megabytes(1);
+        Peer->Memory.PerminantStorage = malloc(Peer->Memory.PerminantStorageSize);
+        Peer->Memory.TransientStorage = malloc(Megabytes(64));
+        Peer->PushBufferSize = Megabytes(1);
+        Peer->PushBuffer = malloc(Peer->PushBufferSize);
+    }
+
+    u32 Failures = 0;
+    u32 LossPercents[] = {0, 10, 20, 40, 60};
+    u32 DelayFrames[] = {0, 4, 8};
+    for (u32 LossIndex = 0; LossIndex < ArraySize(LossPercents); ++LossIndex)
+    {
+        for (u32 DelayIndex = 0; DelayIndex < ArraySize(DelayFrames); ++DelayIndex)
+        {
+            u32 Loss = LossPercents[LossIndex];
+            u32 Delay = DelayFrames[DelayIndex];
+            RunSoak(Peers, Loss, Delay, false);
+
+            lockstep_session *A = &Peers[0].Session;
+            lockstep_session *B = &Peers[1].Session;
+            bool Passed = (A->Desyncs == 0 && B->Desyncs == 0 && A->Tick > 0 && B->Tick > 0);
+            Failures += !Passed;
+            printf("%s loss %2u%% delay %u: ticks %u/%u stalls %u/%u desyncs %u/%u payload %u B/s\n",
+                   Passed ? "ok  " : "FAIL", Loss, Delay, A->Tick, B->Tick,
+                   A->StalledFrames, B->StalledFrames, A->Desyncs, B->Desyncs,
+                   (u32)((A->BytesSent * 60) / SOAK_FRAMES));
+        }
+    }
+
+    RunSoak(Peers, 20, 4, true);
+    lockstep_session *A = &Peers[0].Session;
+    lockstep_session *B = &Peers[1].Session;
+    bool Caught = (A->Desyncs > 0 && B->Desyncs > 0);
+    Failures += !Caught;
+    printf("%s corrupted at frame %u: desyncs %u/%u\n",
+           Caught ? "ok  " : "FAIL", SOAK_CORRUPT_FRAME, A->Desyncs, B->Desyncs);
+
+    printf("%u failures\n", Failures);
+    return(Failures ? 1 : 0);
+}
@@ -1,6 +1,10 @@
+#include <winsock2.h>
 #include <Windows.h>
 
 #include "app.cpp"
+#include "app_mixer.cpp"
+#include "app_net.cpp"
+#include "app_governor.cpp"
 
 struct win32_screen_buffer
 {    
@@ -8,192 +12,1390 @@ struct win32_screen_buffer
     u32 Width = 0;
     u32 Height = 0;
     u8 *Buffer = 0;
+    bool SizeIsLocked = false;
+
+    // NOTE: (Marcus) Set by the frame governor.  The frame is rendered
+    // that many halvings smaller into the top of Buffer and stretched up
+    // when blitting.
+    u32 ResolutionShift = 0;
+};
+
+struct win32_window_dimension
+{
+    int Width;
+    int Height;
+};
+
+global win32_screen_buffer GlobalBackBuffer;
+global bool GlobalWindowRunning;
+global int64_t GlobalPerformanceFrequency;
+
+inline LARGE_INTEGER
+Win32GetWallClock()
+{
+    LARGE_INTEGER Result;
+    QueryPerformanceCounter(&Result);
+    return(Result);
+}
+
+inline win32_window_dimension
+Win32GetWindowDimensions(HWND WindowHandle)
+{
+    win32_window_dimension Result = {};
+    RECT Rect;
+    GetWindowRect(WindowHandle, &Rect);
+    Result.Width = Rect.right - Rect.left;
+    Result.Height = Rect.bottom - Rect.top;
+    return(Result);
+}
+
+inline float
+Win32GetSecondsEllapsed(LARGE_INTEGER StartTime, LARGE_INTEGER EndTime)
+{ 
+    float Result = (float)(EndTime.QuadPart - StartTime.QuadPart)
+        / (float)GlobalPerformanceFrequency;
+    return(Result);
+}
+
+inline void *
+Win32AllocateMemory(u64 Size)
+{
+    void *Result = VirtualAlloc(0, Size, MEM_COMMIT, PAGE_READWRITE);
+    return(Result);
+}
+
+inline void
+Win32ReleaseMemory(void *Data)
+{
+    VirtualFree(Data, 0, MEM_RELEASE);
+}
+
+struct win32_memory_block
+{
+    umi Size;
+    umi Committed;
+    void *Base;
+};
+
+// NOTE: (Marcus) Only reserves the address range, pages get committed
+// through Win32CommitMemory as the game grows into them.
+inline win32_memory_block
+Win32ReserveMemory(umi Size)
+{
+    win32_memory_block Result = {};
+    Result.Base = VirtualAlloc(0, Size, MEM_RESERVE, PAGE_NOACCESS);
+    Result.Size = Result.Base ? Size : 0;
+    return(Result);
+}
+
+internal PLATFORM_COMMIT_MEMORY(Win32CommitMemory)
+{
+    void *Result = VirtualAlloc(Memory, Size, MEM_COMMIT, PAGE_READWRITE);
+    return(Result != 0);
+}
+
+internal bool
+Win32EnableLargePages()
+{
+    bool Result = false;
+    HANDLE Token;
+    if (OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES|TOKEN_QUERY, &Token))
+    {
+        TOKEN_PRIVILEGES Privileges = {};
+        Privileges.PrivilegeCount = 1;
+        Privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+        if (LookupPrivilegeValue(0, SE_LOCK_MEMORY_NAME, &Privileges.Privileges[0].Luid))
+        {
+            AdjustTokenPrivileges(Token, FALSE, &Privileges, 0, 0, 0);
+            Result = (GetLastError() == ERROR_SUCCESS);
+        }
+        CloseHandle(Token);
+    }
+    return(Result);
+}
+
+// NOTE: (Marcus) Hot blocks are committed up front so they never fault in
+// the middle of a frame.  With large pages one TLB entry covers 2MB instead
+// of 4KB.  Large pages have to be committed when they are reserved, so a
+// hot block can not grow past Size.  Without large pages, because the
+// "Lock pages in memory" privilege is missing or the allocation fails, we
+// fall back to normal pages and touch every one of them now.
+internal win32_memory_block
+Win32AllocateHotMemory(umi Size, bool LargePages)
+{
+    win32_memory_block Result = {};
+    umi LargePageSize = GetLargePageMinimum();
+    if (LargePages && LargePageSize)
+    {
+        umi LargeSize = AlignPow2(Size, LargePageSize);
+        Result.Base = VirtualAlloc(0, LargeSize, MEM_RESERVE|MEM_COMMIT|MEM_LARGE_PAGES,
+                                   PAGE_READWRITE);
+        Result.Size = LargeSize;
+    }
+
+    if (!Result.Base)
+    {
+        if (LargePages)
+        {
+            OutputDebugStringA("Large pages unavailable, touching normal pages instead\n");
+        }
+
+        Result.Base = VirtualAlloc(0, Size, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+        Result.Size = Result.Base ? Size : 0;
+        for (umi Offset = 0; Offset < Result.Size; Offset += 4096)
+        {
+            ((volatile u8 *)Result.Base)[Offset] = 0;
+        }
+    }
+
+    Result.Committed = Result.Size;
+    return(Result);
+}
+
+internal void
+Win32ResizeScreenBuffer(u32 Width, u32 Height)
+{
+    if (GlobalBackBuffer.SizeIsLocked)
+    {
+        return;
+    }
+
+    if (GlobalBackBuffer.Buffer) 
+    {
+        Win32ReleaseMemory(GlobalBackBuffer.Buffer);
+        GlobalBackBuffer.Buffer = 0;
+    }
+
+    GlobalBackBuffer.Width = Width;
+    GlobalBackBuffer.Height = Height;
+
+    u32 PixelSize = 4;
+    u32 BufferSize = Width * Height * PixelSize;
+    GlobalBackBuffer.Buffer = (u8 *)Win32AllocateMemory(BufferSize);
+
+    BITMAPINFOHEADER Header = {};
+    Header.biSize = sizeof(BITMAPINFOHEADER);
+    Header.biWidth = Width;
+    Header.biHeight = -Height; // Origin is Top Left
+    Header.biPlanes = 1;
+    Header.biBitCount = 32;
+    Header.biCompression = BI_RGB;
+
+    GlobalBackBuffer.BitmapInfo = {};
+    GlobalBackBuffer.BitmapInfo.bmiHeader = Header;
+}
+
+// NOTE: Returns the pixels filled.
+static u64
+RenderSomething(render_commands *RenderCommands)
+{
+    u64 Result = 0;
+    if (GlobalBackBuffer.Buffer)
+    {
+        u32 Shift = GlobalBackBuffer.ResolutionShift;
+        render_target Target = {};
+        Target.Memory = GlobalBackBuffer.Buffer;
+        Target.Width = GlobalBackBuffer.Width >> Shift;
+        Target.Height = GlobalBackBuffer.Height >> Shift;
+        Target.Pitch = GlobalBackBuffer.Width >> Shift;
+        Target.ResolutionShift = Shift;
+        RenderToTarget<pixel_bgra32>(RenderCommands, &Target);
+        Result = Target.PixelsFilled;
+    }
+    return(Result);
+}
+
+// NOTE: (Marcus) Key messages are queued as events with the time they
+// were pulled off the message queue, read from the performance counter.
+// Message.time is GetTickCount, which only moves every 15.6ms or so.
+// Messages are also pumped while waiting out the frame, see the frame
+// loop, so a key pressed during the wait gets a timestamp within about a
+// millisecond rather than one taken at the next poll.
+struct win32_input_queue
+{
+    app_key_state KeyState[256];
+    u32 EventCount;
+    app_input_event Events[MAX_INPUT_EVENTS];
+};
+
+static void
+Win32PumpMessages(win32_input_queue *Queue)
+{
+    // NOTE: (Marcus) Temporary way to handle messages
+    MSG Message;
+    while (PeekMessageA(&Message, 0, 0, 0, PM_REMOVE))
+    {
+        switch (Message.message)
+        {
+            case WM_QUIT:
+            {
+                GlobalWindowRunning = false;
+            } break;
+
+            // key controls
+            case WM_KEYUP:
+            case WM_KEYDOWN:
+            case WM_SYSKEYUP:
+            case WM_SYSKEYDOWN:
+            {
+                // wParam gives key code.
+                u32 KeyCode = (u32)Message.wParam;
+                #define KeyIsDownBitFlag (1 << 31)
+                #define KeyWasDownBitFlag (1 << 30)
+                bool IsDown  = (KeyIsDownBitFlag  & Message.lParam) == 0;
+                bool WasDown = (KeyWasDownBitFlag & Message.lParam) != 0;
+                if (KeyCode >= ArraySize(Queue->KeyState)) break;
+                Queue->KeyState[KeyCode].IsDown = IsDown;
+
+                // NOTE: Auto repeat is not a transition.
+                if (IsDown != WasDown && Queue->EventCount < MAX_INPUT_EVENTS)
+                {
+                    app_input_event *Event = &Queue->Events[Queue->EventCount++];
+                    Event->KeyCode = KeyCode;
+                    Event->IsDown = IsDown;
+                    Event->Timestamp = (u64)Win32GetWallClock().QuadPart;
+                }
+
+                // char Text[256];
+                // wsprintf(Text, "Key %d IsDown %d WasDown %d \n", KeyCode, IsDown, WasDown);
+                // OutputDebugStringA(Text);
+            } break;
+        }
+
+        TranslateMessage(&Message);
+        DispatchMessage(&Message);
+    }
+}
+
+// NOTE: (Marcus) The frame being simulated covers the time since the last
+// poll, so an event's TimeSecs is how far after LastPoll it was pulled.
+static void
+Win32PollWindowInput(app_input *Input, win32_input_queue *Queue, LARGE_INTEGER LastPoll)
+{
+    Win32PumpMessages(Queue);
+
+    memcpy(Input->OldKeyState, Input->KeyState, sizeof(Input->KeyState));
+    memcpy(Input->KeyState, Queue->KeyState, sizeof(Input->KeyState));
+    Input->EventCount = Queue->EventCount;
+    for (u32 Index = 0; Index < Queue->EventCount; ++Index)
+    {
+        app_input_event *Event = &Input->Events[Index];
+        *Event = Queue->Events[Index];
+        int64_t Timestamp = (int64_t)Event->Timestamp;
+        Timestamp = (Timestamp < LastPoll.QuadPart) ? LastPoll.QuadPart : Timestamp;
+        Event->TimeSecs = Min((float)(Timestamp - LastPoll.QuadPart) /
+                              (float)GlobalPerformanceFrequency,
+                              Input->FrameEllapsedSecs);
+    }
+    Queue->EventCount = 0;
+}
+
+internal void
+Win32BlitImageToScreen(HDC DeviceContext, int ScreenWidth, int ScreenHeight, win32_screen_buffer Buffer)
+{
+    Buffer.Width >>= Buffer.ResolutionShift;
+    Buffer.Height >>= Buffer.ResolutionShift;
+    Buffer.BitmapInfo.bmiHeader.biWidth = Buffer.Width;
+    Buffer.BitmapInfo.bmiHeader.biHeight = -(LONG)Buffer.Height;
+    StretchDIBits(
+        DeviceContext,
+        0, 0, ScreenWidth, ScreenHeight,
+        0, 0, Buffer.Width, Buffer.Height,
+        Buffer.Buffer,
+        &Buffer.BitmapInfo,
+        DIB_RGB_COLORS,
+        SRCCOPY
+    );
+}
+
+internal bool
+Win32GetArgument(char *CommandLine, char *Name, char *Dest, u32 DestSize)
+{
+    bool Result = false;
+    char *At = strstr(CommandLine, Name);
+    if (At && DestSize)
+    {
+        At += strlen(Name);
+        while (*At == ' ') ++At;
+
+        u32 Length = 0;
+        while (*At && *At != ' ' && Length < (DestSize - 1))
+        {
+            Dest[Length++] = *At++;
+        }
+        Dest[Length] = 0;
+        Result = (Length > 0);
+    }
+    return(Result);
+}
+
+#define WIN32_AUDIO_BUFFER_COUNT 3
+#define WIN32_AUDIO_BUFFER_FRAMES 256
+
+struct win32_audio
+{
+    audio_mixer *Mixer;
+    volatile bool Running;
+
+    HANDLE MixerWakeEvent;
+    HANDLE MixerThread;
+    HANDLE BackendThread;
+
+    bool WriteWav;
+    char WavPath[MAX_PATH];
+};
+
+DWORD WINAPI
+Win32MixerThread(LPVOID Parameter)
+{
+    win32_audio *Audio = (win32_audio *)Parameter;
+    while (Audio->Running)
+    {
+        if (!MixerUpdate(Audio->Mixer))
+        {
+            WaitForSingleObject(Audio->MixerWakeEvent, 1);
+        }
+    }
+    return(0);
+}
+
+DWORD WINAPI
+Win32WaveOutThread(LPVOID Parameter)
+{
+    win32_audio *Audio = (win32_audio *)Parameter;
+    audio_mixer *Mixer = Audio->Mixer;
+
+    WAVEFORMATEX Format = {};
+    Format.wFormatTag = WAVE_FORMAT_PCM;
+    Format.nChannels = MIXER_CHANNELS;
+    Format.nSamplesPerSec = MIXER_SAMPLES_PER_SECOND;
+    Format.wBitsPerSample = 16;
+    Format.nBlockAlign = (Format.nChannels * Format.wBitsPerSample) / 8;
+    Format.nAvgBytesPerSec = Format.nSamplesPerSec * Format.nBlockAlign;
+
+    HANDLE BufferDoneEvent = CreateEventA(0, FALSE, FALSE, 0);
+    HWAVEOUT Device;
+    if (waveOutOpen(&Device, WAVE_MAPPER, &Format, (DWORD_PTR)BufferDoneEvent, 0,
+                    CALLBACK_EVENT) == MMSYSERR_NOERROR)
+    {
+        i16 Buffers[WIN32_AUDIO_BUFFER_COUNT][WIN32_AUDIO_BUFFER_FRAMES * MIXER_CHANNELS];
+        WAVEHDR Headers[WIN32_AUDIO_BUFFER_COUNT] = {};
+        bool InFlight[WIN32_AUDIO_BUFFER_COUNT] = {};
+        for (u32 Index = 0; Index < WIN32_AUDIO_BUFFER_COUNT; ++Index)
+        {
+            Headers[Index].lpData = (LPSTR)Buffers[Index];
+            Headers[Index].dwBufferLength = sizeof(Buffers[Index]);
+            waveOutPrepareHeader(Device, &Headers[Index], sizeof(WAVEHDR));
+        }
+
+        while (Audio->Running)
+        {
+            u32 QueuedFrames = 0;
+            for (u32 Index = 0; Index < WIN32_AUDIO_BUFFER_COUNT; ++Index)
+            {
+                WAVEHDR *Header = &Headers[Index];
+                if (!InFlight[Index] || (Header->dwFlags & WHDR_DONE))
+                {
+                    MixerReadFrames(Mixer, Buffers[Index], WIN32_AUDIO_BUFFER_FRAMES);
+                    InFlight[Index] = (waveOutWrite(Device, Header, sizeof(WAVEHDR)) == MMSYSERR_NOERROR);
+                    SetEvent(Audio->MixerWakeEvent);
+                }
+                if (InFlight[Index])
+                {
+                    QueuedFrames += WIN32_AUDIO_BUFFER_FRAMES;
+                }
+            }
+            Mixer->BackendQueuedFrames = QueuedFrames;
+
+            WaitForSingleObject(BufferDoneEvent, 10);
+        }
+
+        waveOutReset(Device);
+        for (u32 Index = 0; Index < WIN32_AUDIO_BUFFER_COUNT; ++Index)
+        {
+            waveOutUnprepareHeader(Device, &Headers[Index], sizeof(WAVEHDR));
+        }
+        waveOutClose(Device);
+    }
+    else
+    {
+        OutputDebugStringA("Failed to open wave out device, no sound\n");
+    }
+
+    CloseHandle(BufferDoneEvent);
+    return(0);
+}
+
+#define RIFF_CODE(A, B, C, D) (((u32)(A) << 0) | ((u32)(B) << 8) | ((u32)(C) << 16) | ((u32)(D) << 24))
+
+#pragma pack(push, 1)
+struct wav_header
+{
+    u32 RiffID;
+    u32 RiffSize;
+    u32 WaveID;
+    u32 FmtID;
+    u32 FmtSize;
+    u16 FormatTag;
+    u16 Channels;
+    u32 SamplesPerSec;
+    u32 AvgBytesPerSec;
+    u16 BlockAlign;
+    u16 BitsPerSample;
+    u32 DataID;
+    u32 DataSize;
+};
+#pragma pack(pop)
+
+inline wav_header
+WavHeader(u32 DataSize)
+{
+    wav_header Result = {};
+    Result.RiffID = RIFF_CODE('R', 'I', 'F', 'F');
+    Result.RiffSize = sizeof(wav_header) - 8 + DataSize;
+    Result.WaveID = RIFF_CODE('W', 'A', 'V', 'E');
+    Result.FmtID = RIFF_CODE('f', 'm', 't', ' ');
+    Result.FmtSize = 16;
+    Result.FormatTag = 1;
+    Result.Channels = MIXER_CHANNELS;
+    Result.SamplesPerSec = MIXER_SAMPLES_PER_SECOND;
+    Result.BlockAlign = MIXER_CHANNELS * sizeof(i16);
+    Result.AvgBytesPerSec = Result.SamplesPerSec * Result.BlockAlign;
+    Result.BitsPerSample = 16;
+    Result.DataID = RIFF_CODE('d', 'a', 't', 'a');
+    Result.DataSize = DataSize;
+    return(Result);
+}
+
+// NOTE: (Marcus) Headless backend for testing.  Drains the mixer at the
+// device rate by the wall clock and writes everything to a WAV file.
+DWORD WINAPI
+Win32WavSinkThread(LPVOID Parameter)
+{
+    win32_audio *Audio = (win32_audio *)Parameter;
+    audio_mixer *Mixer = Audio->Mixer;
+
+    HANDLE File = CreateFileA(Audio->WavPath, GENERIC_WRITE, 0, 0, CREATE_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL, 0);
+    if (File != INVALID_HANDLE_VALUE)
+    {
+        DWORD BytesWritten;
+        wav_header Header = WavHeader(0);
+        WriteFile(File, &Header, sizeof(Header), &BytesWritten, 0);
+
+        i16 Buffer[WIN32_AUDIO_BUFFER_FRAMES * MIXER_CHANNELS];
+        u64 FramesWritten = 0;
+        LARGE_INTEGER StartCounter = Win32GetWallClock();
+        while (Audio->Running)
+        {
+            float Seconds = Win32GetSecondsEllapsed(StartCounter, Win32GetWallClock());
+            u64 FramesDue = (u64)(Seconds * MIXER_SAMPLES_PER_SECOND);
+            while ((FramesWritten + WIN32_AUDIO_BUFFER_FRAMES) <= FramesDue)
+            {
+                MixerReadFrames(Mixer, Buffer, WIN32_AUDIO_BUFFER_FRAMES);
+                WriteFile(File, Buffer, sizeof(Buffer), &BytesWritten, 0);
+                FramesWritten += WIN32_AUDIO_BUFFER_FRAMES;
+                SetEvent(Audio->MixerWakeEvent);
+            }
+            Sleep(2);
+        }
+
+        Header = WavHeader((u32)(FramesWritten * MIXER_CHANNELS * sizeof(i16)));
+        SetFilePointer(File, 0, 0, FILE_BEGIN);
+        WriteFile(File, &Header, sizeof(Header), &BytesWritten, 0);
+        CloseHandle(File);
+    }
+    else
+    {
+        OutputDebugStringA("Failed to open WAV file, no sound\n");
+    }
+
+    return(0);
+}
+
+internal void
+Win32StartAudio(win32_audio *Audio)
+{
+    Audio->Running = true;
+    Audio->MixerWakeEvent = CreateEventA(0, FALSE, FALSE, 0);
+
+    Audio->MixerThread = CreateThread(0, 0, Win32MixerThread, Audio, 0, 0);
+    SetThreadPriority(Audio->MixerThread, THREAD_PRIORITY_TIME_CRITICAL);
+
+    LPTHREAD_START_ROUTINE Backend = Audio->WriteWav ? Win32WavSinkThread : Win32WaveOutThread;
+    Audio->BackendThread = CreateThread(0, 0, Backend, Audio, 0, 0);
+    SetThreadPriority(Audio->BackendThread, THREAD_PRIORITY_TIME_CRITICAL);
+}
+
+internal void
+Win32StopAudio(win32_audio *Audio)
+{
+    Audio->Running = false;
+    SetEvent(Audio->MixerWakeEvent);
+    WaitForSingleObject(Audio->MixerThread, INFINITE);
+    WaitForSingleObject(Audio->BackendThread, INFINITE);
+    CloseHandle(Audio->MixerThread);
+    CloseHandle(Audio->BackendThread);
+    CloseHandle(Audio->MixerWakeEvent);
+}
+
+// NOTE: (Marcus) Frame capture.  The back buffer is always one of a pool of
+// capture buffers.  After a frame is presented the whole buffer is handed
+// to the capture thread and a free one takes its place, so nothing gets
+// copied on the main thread.  When no buffer is free the frame is dropped
+// and the next one renders over it.  The back buffer size is locked while
+// capturing, the window still stretches it to fit.
+//
+// '.y4m' files get YUV 4:2:0, anything else gets raw BGRA frames.
+
+#define WIN32_CAPTURE_BUFFER_COUNT 8
+
+struct win32_capture_ring
+{
+    volatile u32 ReadIndex;
+    volatile u32 WriteIndex;
+    u32 Entries[WIN32_CAPTURE_BUFFER_COUNT];
+};
+
+struct win32_capture
+{
+    bool Active;
+    bool WriteY4M;
+    volatile bool Running;
+    char Path[MAX_PATH];
+
+    HANDLE File;
+    HANDLE Thread;
+    HANDLE WakeEvent;
+
+    u32 Width;
+    u32 Height;
+    u32 CurrentBuffer;
+    u8 *Buffers[WIN32_CAPTURE_BUFFER_COUNT];
+    win32_capture_ring Full;
+    win32_capture_ring Free;
+
+    umi StagingSize;
+    umi StagingUsed;
+    u8 *Staging;
+
+    volatile u32 FramesWritten;
+    u32 FramesDropped;
+    float SubmitSecs;
+};
+
+inline bool
+CaptureRingPush(win32_capture_ring *Ring, u32 Entry)
+{
+    bool Result = false;
+    u32 WriteIndex = Ring->WriteIndex;
+    if ((WriteIndex - Ring->ReadIndex) < WIN32_CAPTURE_BUFFER_COUNT)
+    {
+        Ring->Entries[WriteIndex % WIN32_CAPTURE_BUFFER_COUNT] = Entry;
+        CompletePreviousWritesBeforeFutureWrites;
+        Ring->WriteIndex = WriteIndex + 1;
+        Result = true;
+    }
+    return(Result);
+}
+
+inline bool
+CaptureRingPop(win32_capture_ring *Ring, u32 *Entry)
+{
+    bool Result = false;
+    u32 ReadIndex = Ring->ReadIndex;
+    if (ReadIndex != Ring->WriteIndex)
+    {
+        CompletePreviousReadsBeforeFutureReads;
+        *Entry = Ring->Entries[ReadIndex % WIN32_CAPTURE_BUFFER_COUNT];
+        CompletePreviousReadsBeforeFutureReads;
+        Ring->ReadIndex = ReadIndex + 1;
+        Result = true;
+    }
+    return(Result);
+}
+
+internal void
+Win32CaptureFlush(win32_capture *Capture)
+{
+    if (Capture->StagingUsed)
+    {
+        DWORD BytesWritten;
+        WriteFile(Capture->File, Capture->Staging, (DWORD)Capture->StagingUsed, &BytesWritten, 0);
+        Capture->StagingUsed = 0;
+    }
+}
+
+// NOTE: Small writes are gathered into the staging buffer, anything as big
+// as the staging buffer goes straight to the file.
+internal u8 *
+Win32CaptureReserve(win32_capture *Capture, umi Size)
+{
+    Assert(Size <= Capture->StagingSize);
+    if ((Capture->StagingUsed + Size) > Capture->StagingSize)
+    {
+        Win32CaptureFlush(Capture);
+    }
+    u8 *Result = Capture->Staging + Capture->StagingUsed;
+    Capture->StagingUsed += Size;
+    return(Result);
+}
+
+inline __m128i
+MultiplyLanes(__m128i Lanes, i16 Constant)
+{
+    // NOTE: Each 32 bit lane holds one 0-255 value in its low half, madd
+    // against (Constant, 0) gives the exact signed 32 bit product.
+    __m128i Result = _mm_madd_epi16(Lanes, _mm_set1_epi32((u16)Constant));
+    return(Result);
+}
+
+inline void
+SplitBGRA(__m128i Pixels, __m128i *B, __m128i *G, __m128i *R)
+{
+    __m128i Mask = _mm_set1_epi32(0xFF);
+    *B = _mm_and_si128(Pixels, Mask);
+    *G = _mm_and_si128(_mm_srli_epi32(Pixels, 8), Mask);
+    *R = _mm_and_si128(_mm_srli_epi32(Pixels, 16), Mask);
+}
+
+inline __m128i
+LumaOf(__m128i Pixels)
+{
+    __m128i B, G, R;
+    SplitBGRA(Pixels, &B, &G, &R);
+    __m128i Sum = _mm_add_epi32(_mm_add_epi32(MultiplyLanes(R, 77), MultiplyLanes(G, 150)),
+                                _mm_add_epi32(MultiplyLanes(B, 29), _mm_set1_epi32(128)));
+    __m128i Result = _mm_srai_epi32(Sum, 8);
+    return(Result);
+}
+
+inline __m128i
+PairSums(__m128i A, __m128i B)
+{
+    // NOTE: (a0+a1, a2+a3, b0+b1, b2+b3)
+    __m128 Even = _mm_shuffle_ps(_mm_castsi128_ps(A), _mm_castsi128_ps(B), _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 Odd = _mm_shuffle_ps(_mm_castsi128_ps(A), _mm_castsi128_ps(B), _MM_SHUFFLE(3, 1, 3, 1));
+    __m128i Result = _mm_add_epi32(_mm_castps_si128(Even), _mm_castps_si128(Odd));
+    return(Result);
+}
+
+inline __m128i
+PackLanesToBytes(__m128i A, __m128i B)
+{
+    __m128i Words = _mm_packs_epi32(A, B);
+    __m128i Result = _mm_packus_epi16(Words, Words);
+    return(Result);
+}
+
+inline void
+Y4MPixelScalar(u32 *RowA, u32 *RowB, u32 X, u8 *YA, u8 *YB, u8 *U, u8 *V)
+{
+    i32 SumR = 0, SumG = 0, SumB = 0;
+    u32 Pixels[4] = {RowA[X], RowA[X + 1], RowB[X], RowB[X + 1]};
+    u8 *Luma[4] = {YA + X, YA + X + 1, YB + X, YB + X + 1};
+    for (u32 Index = 0; Index < 4; ++Index)
+    {
+        i32 B = (Pixels[Index] >> 0) & 0xFF;
+        i32 G = (Pixels[Index] >> 8) & 0xFF;
+        i32 R = (Pixels[Index] >> 16) & 0xFF;
+        *Luma[Index] = (u8)((77*R + 150*G + 29*B + 128) >> 8);
+        SumR += R;
+        SumG += G;
+        SumB += B;
+    }
+
+    i32 R = (SumR + 2) >> 2;
+    i32 G = (SumG + 2) >> 2;
+    i32 B = (SumB + 2) >> 2;
+    i32 Cb = ((-43*R - 85*G + 128*B + 128) >> 8) + 128;
+    i32 Cr = ((128*R - 107*G - 21*B + 128) >> 8) + 128;
+    U[X / 2] = (u8)(Cb < 0 ? 0 : Cb > 255 ? 255 : Cb);
+    V[X / 2] = (u8)(Cr < 0 ? 0 : Cr > 255 ? 255 : Cr);
+}
+
+// NOTE: (Marcus) BT.601 full range, chroma is the average of each 2x2
+// block.  8 pixels from each of two rows per iteration.
+internal void
+ConvertBGRAToYUV420(u8 *Source, u32 Width, u32 Height, u32 Pitch, u8 *Dest)
+{
+    u8 *PlaneY = Dest;
+    u8 *PlaneU = PlaneY + Width*Height;
+    u8 *PlaneV = PlaneU + (Width/2)*(Height/2);
+
+    for (u32 Y = 0; Y < Height; Y += 2)
+    {
+        u32 *RowA = (u32 *)(Source + Y*Pitch);
+        u32 *RowB = (u32 *)(Source + (Y + 1)*Pitch);
+        u8 *YA = PlaneY + Y*Width;
+        u8 *YB = YA + Width;
+        u8 *U = PlaneU + (Y/2)*(Width/2);
+        u8 *V = PlaneV + (Y/2)*(Width/2);
+
+        u32 X = 0;
+        for (; (X + 8) <= Width; X += 8)
+        {
+            __m128i A0 = _mm_loadu_si128((__m128i *)(RowA + X));
+            __m128i A1 = _mm_loadu_si128((__m128i *)(RowA + X + 4));
+            __m128i B0 = _mm_loadu_si128((__m128i *)(RowB + X));
+            __m128i B1 = _mm_loadu_si128((__m128i *)(RowB + X + 4));
+
+            _mm_storel_epi64((__m128i *)(YA + X), PackLanesToBytes(LumaOf(A0), LumaOf(A1)));
+            _mm_storel_epi64((__m128i *)(YB + X), PackLanesToBytes(LumaOf(B0), LumaOf(B1)));
+
+            __m128i BA0, GA0, RA0, BA1, GA1, RA1, BB0, GB0, RB0, BB1, GB1, RB1;
+            SplitBGRA(A0, &BA0, &GA0, &RA0);
+            SplitBGRA(A1, &BA1, &GA1, &RA1);
+            SplitBGRA(B0, &BB0, &GB0, &RB0);
+            SplitBGRA(B1, &BB1, &GB1, &RB1);
+
+            __m128i Two = _mm_set1_epi32(2);
+            __m128i R = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(PairSums(RA0, RA1), PairSums(RB0, RB1)), Two), 2);
+            __m128i G = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(PairSums(GA0, GA1), PairSums(GB0, GB1)), Two), 2);
+            __m128i B = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(PairSums(BA0, BA1), PairSums(BB0, BB1)), Two), 2);
+
+            __m128i Round = _mm_set1_epi32(128);
+            __m128i Cb = _mm_add_epi32(MultiplyLanes(B, 128), Round);
+            Cb = _mm_sub_epi32(Cb, _mm_add_epi32(MultiplyLanes(R, 43), MultiplyLanes(G, 85)));
+            Cb = _mm_add_epi32(_mm_srai_epi32(Cb, 8), Round);
+            __m128i Cr = _mm_add_epi32(MultiplyLanes(R, 128), Round);
+            Cr = _mm_sub_epi32(Cr, _mm_add_epi32(MultiplyLanes(G, 107), MultiplyLanes(B, 21)));
+            Cr = _mm_add_epi32(_mm_srai_epi32(Cr, 8), Round);
+
+            *(u32 *)(U + X/2) = (u32)_mm_cvtsi128_si32(PackLanesToBytes(Cb, Cb));
+            *(u32 *)(V + X/2) = (u32)_mm_cvtsi128_si32(PackLanesToBytes(Cr, Cr));
+        }
+
+        for (; X < Width; X += 2)
+        {
+            Y4MPixelScalar(RowA, RowB, X, YA, YB, U, V);
+        }
+    }
+}
+
+DWORD WINAPI
+Win32CaptureThread(LPVOID Parameter)
+{
+    win32_capture *Capture = (win32_capture *)Parameter;
+    umi Pitch = Capture->Width * 4;
+    umi FrameSize = Capture->WriteY4M
+        ? (6 + Capture->Width*Capture->Height + 2*(Capture->Width/2)*(Capture->Height/2))
+        : (Pitch * Capture->Height);
+
+    // NOTE: Finish whatever is queued before shutting down.
+    u32 BufferIndex;
+    while (Capture->Running || Capture->Full.ReadIndex != Capture->Full.WriteIndex)
+    {
+        if (!CaptureRingPop(&Capture->Full, &BufferIndex))
+        {
+            WaitForSingleObject(Capture->WakeEvent, 5);
+            continue;
+        }
+
+        u8 *Frame = Capture->Buffers[BufferIndex];
+        if (Capture->WriteY4M)
+        {
+            u8 *Dest = Win32CaptureReserve(Capture, FrameSize);
+            memcpy(Dest, "FRAME\n", 6);
+            ConvertBGRAToYUV420(Frame, Capture->Width, Capture->Height, (u32)Pitch, Dest + 6);
+        }
+        else if (FrameSize >= Capture->StagingSize)
+        {
+            Win32CaptureFlush(Capture);
+            DWORD BytesWritten;
+            WriteFile(Capture->File, Frame, (DWORD)FrameSize, &BytesWritten, 0);
+        }
+        else
+        {
+            memcpy(Win32CaptureReserve(Capture, FrameSize), Frame, FrameSize);
+        }
+
+        CaptureRingPush(&Capture->Free, BufferIndex);
+        ++Capture->FramesWritten;
+    }
+
+    Win32CaptureFlush(Capture);
+    return(0);
+}
+
+internal bool
+Win32StartCapture(win32_capture *Capture, u32 FramesPerSecond)
+{
+    umi PathLength = strlen(Capture->Path);
+    Capture->WriteY4M = (PathLength > 4) && (strcmp(Capture->Path + PathLength - 4, ".y4m") == 0);
+    Capture->File = CreateFileA(Capture->Path, GENERIC_WRITE, 0, 0, CREATE_ALWAYS,
+                                FILE_ATTRIBUTE_NORMAL|FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (Capture->File == INVALID_HANDLE_VALUE || !GlobalBackBuffer.Buffer)
+    {
+        OutputDebugStringA("Failed to start capture\n");
+        return(false);
+    }
+
+    // NOTE: 4:2:0 needs an even size, an odd last row or column is left off.
+    Capture->Width = GlobalBackBuffer.Width;
+    Capture->Height = GlobalBackBuffer.Height;
+    if (Capture->WriteY4M)
+    {
+        Capture->Width &= ~1;
+        Capture->Height &= ~1;
+        Win32ResizeScreenBuffer(Capture->Width, Capture->Height);
+    }
+
+    umi BufferSize = GlobalBackBuffer.Width * GlobalBackBuffer.Height * 4;
+    for (u32 Index = 0; Index < WIN32_CAPTURE_BUFFER_COUNT; ++Index)
+    {
+        Capture->Buffers[Index] = (u8 *)Win32AllocateMemory(BufferSize);
+        if (Index) CaptureRingPush(&Capture->Free, Index);
+    }
+
+    Win32ReleaseMemory(GlobalBackBuffer.Buffer);
+    GlobalBackBuffer.Buffer = Capture->Buffers[0];
+    GlobalBackBuffer.SizeIsLocked = true;
+    Capture->CurrentBuffer = 0;
+
+    Capture->StagingSize = Megabytes(16);
+    if (Capture->StagingSize < BufferSize)
+    {
+        Capture->StagingSize = BufferSize;
+    }
+    Capture->Staging = (u8 *)Win32AllocateMemory(Capture->StagingSize);
+
+    if (Capture->WriteY4M)
+    {
+        char Header[128];
+        wsprintf(Header, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n",
+                 Capture->Width, Capture->Height, FramesPerSecond);
+        u8 *Dest = Win32CaptureReserve(Capture, strlen(Header));
+        memcpy(Dest, Header, strlen(Header));
+    }
+
+    Capture->Running = true;
+    Capture->Active = true;
+    Capture->WakeEvent = CreateEventA(0, FALSE, FALSE, 0);
+    Capture->Thread = CreateThread(0, 0, Win32CaptureThread, Capture, 0, 0);
+    return(true);
+}
+
+// NOTE: (Marcus) Main thread, right after the frame is presented.
+internal void
+Win32CaptureFrame(win32_capture *Capture)
+{
+    LARGE_INTEGER Start = Win32GetWallClock();
+
+    u32 NextBuffer;
+    if (CaptureRingPop(&Capture->Free, &NextBuffer))
+    {
+        CaptureRingPush(&Capture->Full, Capture->CurrentBuffer);
+        SetEvent(Capture->WakeEvent);
+
+        Capture->CurrentBuffer = NextBuffer;
+        GlobalBackBuffer.Buffer = Capture->Buffers[NextBuffer];
+    }
+    else
+    {
+        ++Capture->FramesDropped;
+    }
+
+    Capture->SubmitSecs = Win32GetSecondsEllapsed(Start, Win32GetWallClock());
+}
+
+internal void
+Win32StopCapture(win32_capture *Capture)
+{
+    Capture->Running = false;
+    SetEvent(Capture->WakeEvent);
+    WaitForSingleObject(Capture->Thread, INFINITE);
+    CloseHandle(Capture->Thread);
+    CloseHandle(Capture->WakeEvent);
+    CloseHandle(Capture->File);
+
+    char Text[256];
+    wsprintf(Text, "Capture finished: %d frames written, %d dropped\n",
+             Capture->FramesWritten, Capture->FramesDropped);
+    OutputDebugStringA(Text);
+}
+
+// NOTE: (Marcus) Counters.  Every frame's app_counters go into a named
+// shared memory block that win32_nsi_counters.exe, or any other local
+// tool, can sample without stopping the game.  The name carries our
+// process id so two games never write the same block.
+//
+// -csv <file> also writes one row per frame.  Rows go into a staging
+// buffer and full buffers are handed to a writer thread through the same
+// rings capture uses, so the main thread never touches the file.  When
+// no buffer is free the row is dropped.
+#define WIN32_CSV_BUFFER_COUNT 4
+#define WIN32_CSV_STAGING_SIZE Kilobytes(64)
+
+struct win32_counters
+{
+    HANDLE Mapping;
+    app_counters_block *Block;
+
+    HANDLE CsvFile;
+    HANDLE CsvThread;
+    HANDLE CsvWakeEvent;
+    volatile bool CsvRunning;
+
+    u32 CsvBuffer;
+    umi CsvUsed[WIN32_CSV_BUFFER_COUNT];
+    char *CsvStaging[WIN32_CSV_BUFFER_COUNT];
+    win32_capture_ring CsvFull;
+    win32_capture_ring CsvFree;
+    u32 CsvRowsDropped;
 };
 
-struct win32_window_dimension
-{
-    int Width;
-    int Height;
-};
+internal char *
+Win32AppendU64(char *At, u64 Value)
+{
+    char Digits[20];
+    u32 Count = 0;
+    do
+    {
+        Digits[Count++] = (char)('0' + (Value % 10));
+        Value /= 10;
+    } while (Value);
+
+    while (Count)
+    {
+        *At++ = Digits[--Count];
+    }
+    return(At);
+}
+
+DWORD WINAPI
+Win32CsvThread(LPVOID Parameter)
+{
+    win32_counters *Counters = (win32_counters *)Parameter;
+    while (Counters->CsvRunning || Counters->CsvFull.ReadIndex != Counters->CsvFull.WriteIndex)
+    {
+        u32 BufferIndex;
+        if (!CaptureRingPop(&Counters->CsvFull, &BufferIndex))
+        {
+            WaitForSingleObject(Counters->CsvWakeEvent, 100);
+            continue;
+        }
+
+        DWORD BytesWritten;
+        WriteFile(Counters->CsvFile, Counters->CsvStaging[BufferIndex],
+                  (DWORD)Counters->CsvUsed[BufferIndex], &BytesWritten, 0);
+        Counters->CsvUsed[BufferIndex] = 0;
+        CaptureRingPush(&Counters->CsvFree, BufferIndex);
+    }
+    return(0);
+}
+
+// NOTE: Hands the current buffer to the writer.  False if there is no free
+// buffer to carry on in, the current one is kept.
+internal bool
+Win32SubmitCsv(win32_counters *Counters)
+{
+    bool Result = false;
+    u32 NextBuffer;
+    if (CaptureRingPop(&Counters->CsvFree, &NextBuffer))
+    {
+        CaptureRingPush(&Counters->CsvFull, Counters->CsvBuffer);
+        SetEvent(Counters->CsvWakeEvent);
+        Counters->CsvBuffer = NextBuffer;
+        Result = true;
+    }
+    return(Result);
+}
+
+internal void
+Win32StartCounters(win32_counters *Counters, char *CsvPath)
+{
+    Assert(ArraySize(AppCounterNames) == APP_COUNTER_COUNT);
+    Assert(WIN32_CSV_BUFFER_COUNT <= WIN32_CAPTURE_BUFFER_COUNT);
+
+    char Name[64];
+    wsprintf(Name, APP_COUNTERS_SHARED_NAME, GetCurrentProcessId());
+    Counters->Mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, 0, PAGE_READWRITE, 0,
+                                           sizeof(app_counters_block), Name);
+    // NOTE: Somebody else's block, a second writer would break the seqlock.
+    if (Counters->Mapping && GetLastError() == ERROR_ALREADY_EXISTS)
+    {
+        CloseHandle(Counters->Mapping);
+        Counters->Mapping = 0;
+    }
+    if (Counters->Mapping)
+    {
+        Counters->Block = (app_counters_block *)MapViewOfFile(Counters->Mapping, FILE_MAP_WRITE,
+                                                              0, 0, sizeof(app_counters_block));
+    }
+    if (Counters->Block)
+    {
+        Counters->Block->Version = APP_COUNTERS_VERSION;
+        Counters->Block->Size = sizeof(app_counters);
+    }
+    else
+    {
+        OutputDebugStringA("Failed to map the counters block\n");
+    }
+
+    Counters->CsvFile = INVALID_HANDLE_VALUE;
+    if (CsvPath)
+    {
+        Counters->CsvFile = CreateFileA(CsvPath, GENERIC_WRITE, 0, 0, CREATE_ALWAYS,
+                                        FILE_ATTRIBUTE_NORMAL, 0);
+        if (Counters->CsvFile == INVALID_HANDLE_VALUE)
+        {
+            OutputDebugStringA("Failed to open the counters CSV file\n");
+            return;
+        }
+
+        for (u32 Index = 0; Index < WIN32_CSV_BUFFER_COUNT; ++Index)
+        {
+            Counters->CsvStaging[Index] = (char *)Win32AllocateMemory(WIN32_CSV_STAGING_SIZE);
+            if (Index) CaptureRingPush(&Counters->CsvFree, Index);
+        }
+        Counters->CsvBuffer = 0;
+
+        char *At = Counters->CsvStaging[0];
+        for (u32 Index = 0; Index < APP_COUNTER_COUNT; ++Index)
+        {
+            At += wsprintf(At, Index ? ",%s" : "%s", AppCounterNames[Index]);
+        }
+        *At++ = '\n';
+        Counters->CsvUsed[0] = At - Counters->CsvStaging[0];
 
-global win32_screen_buffer GlobalBackBuffer;
-global bool GlobalWindowRunning;
-global int64_t GlobalPerformanceFrequency;
+        Counters->CsvRunning = true;
+        Counters->CsvWakeEvent = CreateEventA(0, FALSE, FALSE, 0);
+        Counters->CsvThread = CreateThread(0, 0, Win32CsvThread, Counters, 0, 0);
+    }
+}
 
-inline LARGE_INTEGER
-Win32GetWallClock()
+internal void
+Win32PublishCounters(win32_counters *Counters, app_counters *Values)
 {
-    LARGE_INTEGER Result;
-    QueryPerformanceCounter(&Result);
-    return(Result);
+    if (Counters->Block)
+    {
+        PublishCounters(Counters->Block, Values);
+    }
+
+    if (Counters->CsvThread)
+    {
+        // NOTE: Worst case is 20 digits and a separator per counter.
+        umi Used = Counters->CsvUsed[Counters->CsvBuffer];
+        if ((Used + 21*APP_COUNTER_COUNT) > WIN32_CSV_STAGING_SIZE)
+        {
+            if (!Win32SubmitCsv(Counters))
+            {
+                ++Counters->CsvRowsDropped;
+                return;
+            }
+            Used = Counters->CsvUsed[Counters->CsvBuffer];
+        }
+
+        u64 *Value = (u64 *)Values;
+        char *Start = Counters->CsvStaging[Counters->CsvBuffer];
+        char *At = Start + Used;
+        for (u32 Index = 0; Index < APP_COUNTER_COUNT; ++Index)
+        {
+            if (Index) *At++ = ',';
+            At = Win32AppendU64(At, Value[Index]);
+        }
+        *At++ = '\n';
+        Counters->CsvUsed[Counters->CsvBuffer] = At - Start;
+    }
 }
 
-inline win32_window_dimension
-Win32GetWindowDimensions(HWND WindowHandle)
+internal void
+Win32StopCounters(win32_counters *Counters)
 {
-    win32_window_dimension Result = {};
-    RECT Rect;
-    GetWindowRect(WindowHandle, &Rect);
-    Result.Width = Rect.right - Rect.left;
-    Result.Height = Rect.bottom - Rect.top;
-    return(Result);
-}
+    if (Counters->CsvThread)
+    {
+        // NOTE: The last partial buffer.  All the others are free or
+        // queued by now, so there is nowhere else for it to wait.
+        CaptureRingPush(&Counters->CsvFull, Counters->CsvBuffer);
+        Counters->CsvRunning = false;
+        SetEvent(Counters->CsvWakeEvent);
+        WaitForSingleObject(Counters->CsvThread, INFINITE);
+        CloseHandle(Counters->CsvThread);
+        CloseHandle(Counters->CsvWakeEvent);
 
-inline float
-Win32GetSecondsEllapsed(LARGE_INTEGER StartTime, LARGE_INTEGER EndTime)
-{ 
-    float Result = (float)(EndTime.QuadPart - StartTime.QuadPart)
-        / (float)GlobalPerformanceFrequency;
-    return(Result);
+        for (u32 Index = 0; Index < WIN32_CSV_BUFFER_COUNT; ++Index)
+        {
+            Win32ReleaseMemory(Counters->CsvStaging[Index]);
+        }
+
+        if (Counters->CsvRowsDropped)
+        {
+            char Text[128];
+            wsprintf(Text, "Counters CSV dropped %d rows\n", Counters->CsvRowsDropped);
+            OutputDebugStringA(Text);
+        }
+    }
+    if (Counters->CsvFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(Counters->CsvFile);
+    }
+    if (Counters->Block)
+    {
+        UnmapViewOfFile(Counters->Block);
+    }
+    if (Counters->Mapping)
+    {
+        CloseHandle(Counters->Mapping);
+    }
 }
 
-inline void *
-Win32AllocateMemory(u64 Size)
+// NOTE: (Marcus) UDP transport for app_net.cpp.  The socket never blocks,
+// everything that arrived is drained once a frame.  Sends can go through
+// a simulated bad link, LossPercent of packets vanish and the rest are
+// held back DelayMS, so lockstep can be tested on one machine.
+#define WIN32_NET_MAX_PENDING 256
+
+struct win32_net_packet
 {
-    void *Result = VirtualAlloc(0, Size, MEM_COMMIT, PAGE_READWRITE);
+    LARGE_INTEGER SendAt;
+    u32 Size;
+    u8 Data[NET_MAX_PACKET_SIZE];
+};
+
+struct win32_net_peer
+{
+    SOCKET Socket;
+    sockaddr_in PeerAddress;
+    bool HasPeerAddress;
+
+    u32 LossPercent;
+    u32 DelayMS;
+    u32 RandomState;
+    u32 PendingCount;
+    win32_net_packet Pending[WIN32_NET_MAX_PENDING];
+
+    lockstep_session Session;
+};
+
+internal u32
+Win32ParseU32(char *Text)
+{
+    u32 Result = 0;
+    while (*Text >= '0' && *Text <= '9')
+    {
+        Result = (Result * 10) + (u32)(*Text++ - '0');
+    }
     return(Result);
 }
 
-inline void
-Win32ReleaseMemory(void *Data)
+internal bool
+Win32OpenNetPeer(win32_net_peer *Peer, u32 Port, u32 LocalPlayer, u32 InputDelay)
 {
-    VirtualFree(Data, 0, MEM_RELEASE);
+    Peer->Socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (Peer->Socket == INVALID_SOCKET) return(false);
+
+    sockaddr_in Address = {};
+    Address.sin_family = AF_INET;
+    Address.sin_port = htons((u_short)Port);
+    Address.sin_addr.s_addr = htonl(INADDR_ANY);
+    u_long NonBlocking = 1;
+    if (bind(Peer->Socket, (sockaddr *)&Address, sizeof(Address)) == SOCKET_ERROR ||
+        ioctlsocket(Peer->Socket, FIONBIO, &NonBlocking) == SOCKET_ERROR)
+    {
+        closesocket(Peer->Socket);
+        Peer->Socket = INVALID_SOCKET;
+        return(false);
+    }
+
+    Peer->RandomState = 0x9E3779B9 ^ Port;
+    InitializeLockstep(&Peer->Session, LocalPlayer, InputDelay);
+    return(true);
 }
 
+// NOTE: "a.b.c.d:port"
 internal void
-Win32ResizeScreenBuffer(u32 Width, u32 Height)
+Win32SetNetPeerAddress(win32_net_peer *Peer, char *HostAndPort)
 {
-    if (GlobalBackBuffer.Buffer) 
+    char Host[64] = {};
+    u32 Length = 0;
+    char *At = HostAndPort;
+    while (*At && *At != ':' && Length < (sizeof(Host) - 1))
     {
-        Win32ReleaseMemory(&GlobalBackBuffer.Buffer);
-        GlobalBackBuffer.Buffer = 0;
+        Host[Length++] = *At++;
     }
 
-    GlobalBackBuffer.Width = Width;
-    GlobalBackBuffer.Height = Height;
-
-    u32 PixelSize = 4;
-    u32 BufferSize = Width * Height * PixelSize;
-    GlobalBackBuffer.Buffer = (u8 *)Win32AllocateMemory(BufferSize);
+    Peer->PeerAddress = {};
+    Peer->PeerAddress.sin_family = AF_INET;
+    Peer->PeerAddress.sin_addr.s_addr = inet_addr(Host);
+    Peer->PeerAddress.sin_port = htons((u_short)((*At == ':') ? Win32ParseU32(At + 1) : 0));
+    Peer->HasPeerAddress = true;
+}
 
-    BITMAPINFOHEADER Header = {};
-    Header.biSize = sizeof(BITMAPINFOHEADER);
-    Header.biWidth = Width;
-    Header.biHeight = -Height; // Origin is Top Left
-    Header.biPlanes = 1;
-    Header.biBitCount = 32;
-    Header.biCompression = BI_RGB;
+inline u32
+Win32NetRandom(win32_net_peer *Peer)
+{
+    u32 X = Peer->RandomState;
+    X ^= X << 13;
+    X ^= X >> 17;
+    X ^= X << 5;
+    Peer->RandomState = X;
+    return(X);
+}
 
-    GlobalBackBuffer.BitmapInfo = {};
-    GlobalBackBuffer.BitmapInfo.bmiHeader = Header;
+internal void
+Win32NetFlush(win32_net_peer *Peer)
+{
+    LARGE_INTEGER Now = Win32GetWallClock();
+    for (u32 Index = 0; Index < Peer->PendingCount;)
+    {
+        win32_net_packet *Packet = &Peer->Pending[Index];
+        if (Packet->SendAt.QuadPart <= Now.QuadPart)
+        {
+            sendto(Peer->Socket, (char *)Packet->Data, Packet->Size, 0,
+                   (sockaddr *)&Peer->PeerAddress, sizeof(Peer->PeerAddress));
+            *Packet = Peer->Pending[--Peer->PendingCount];
+        }
+        else
+        {
+            ++Index;
+        }
+    }
 }
 
-static void
-RenderSomething(render_commands *RenderCommands)
+internal void
+Win32NetSend(win32_net_peer *Peer)
 {
-    if (GlobalBackBuffer.Buffer)
+    u8 Data[NET_MAX_PACKET_SIZE];
+    u32 Size = LockstepWritePacket(&Peer->Session, Data, sizeof(Data));
+    bool Lost = (Win32NetRandom(Peer) % 100) < Peer->LossPercent;
+    if (Size && Peer->HasPeerAddress && !Lost && Peer->PendingCount < WIN32_NET_MAX_PENDING)
     {
-        u32 BufferWidth = GlobalBackBuffer.Width;
-        u32 BufferHeight = GlobalBackBuffer.Height;
+        win32_net_packet *Packet = &Peer->Pending[Peer->PendingCount++];
+        Packet->SendAt = Win32GetWallClock();
+        Packet->SendAt.QuadPart += ((int64_t)Peer->DelayMS * GlobalPerformanceFrequency) / 1000;
+        Packet->Size = Size;
+        memcpy(Packet->Data, Data, Size);
+    }
+    Win32NetFlush(Peer);
+}
 
-        void *BufferEntry = RenderCommands->PushBuffer;
-        for (umi Index = 0; 
-             Index < RenderCommands->PushBufferEntryCount; 
-             ++Index)
+// NOTE: The host does not know who will join, it takes the address of the
+// first packet that shows up and ignores everyone else after that.
+internal void
+Win32NetReceive(win32_net_peer *Peer)
+{
+    for (;;)
+    {
+        u8 Data[NET_MAX_PACKET_SIZE];
+        sockaddr_in From = {};
+        int FromSize = sizeof(From);
+        int Size = recvfrom(Peer->Socket, (char *)Data, sizeof(Data), 0, (sockaddr *)&From, &FromSize);
+        if (Size == SOCKET_ERROR)
         {
-            render_command_header *Header = (render_command_header *)BufferEntry;
-            switch (Header->Type)
-            {
-                case RenderCommand_Rectangle:
-                {
-                    render_rectangle *Command =
-                        (render_rectangle *)((u8 *)Header + sizeof(render_command_header));
-                    
-                    for (u32 Y = Command->Y;
-                         Y < (Command->Y + Command->Height);
-                         ++Y)
-                    {
-                        for (u32 X = Command->X;
-                             X < (Command->X + Command->Width);
-                             ++X)
-                        {
-                            u32 Offset = ((X % BufferWidth) + ((Y % BufferHeight) * BufferWidth));
-                            u32 *Pixel = ((u32 *)GlobalBackBuffer.Buffer + Offset);
-                            *Pixel = Command->Color;
-                        }
-                    }
-                } break;
-
-                case RenderCommand_Clear:
-                {
-                    render_clear_color *Command =
-                        (render_clear_color *)((u8 *)Header + sizeof(render_command_header));
+            // NOTE: Windows reports an earlier send that bounced off a
+            // closed port here, that is not a reason to stop reading.
+            if (WSAGetLastError() == WSAECONNRESET) continue;
+            break;
+        }
 
-                    for (u32 Index = 0; Index < (BufferWidth*BufferHeight); ++Index)
-                    {
-                        u32 *Pixel = ((u32 *)GlobalBackBuffer.Buffer + Index);
-                        *Pixel = Command->Color;
-                    }
-                } break;
-            }
+        if (!Peer->HasPeerAddress)
+        {
+            Peer->PeerAddress = From;
+            Peer->HasPeerAddress = true;
+        }
 
-            BufferEntry = (u8 *)BufferEntry + Header->Size;
+        if (From.sin_addr.s_addr == Peer->PeerAddress.sin_addr.s_addr &&
+            From.sin_port == Peer->PeerAddress.sin_port)
+        {
+            LockstepReadPacket(&Peer->Session, Data, (u32)Size);
         }
     }
 }
 
-static void
-Win32PollWindowInput(app_input *Input)
+internal void
+Win32CloseNetPeer(win32_net_peer *Peer)
 {
-    // NOTE: (Marcus) Temporary way to handle messages
-    MSG Message;
-    while (PeekMessageA(&Message, 0, 0, 0, PM_REMOVE))
+    if (Peer->Socket != INVALID_SOCKET)
     {
-        switch (Message.message)
-        {
-            case WM_QUIT:
-            {
-                GlobalWindowRunning = false;
-            } break;
+        closesocket(Peer->Socket);
+    }
+}
 
-            // key controls
-            case WM_KEYUP:
-            case WM_KEYDOWN:
-            case WM_SYSKEYUP:
-            case WM_SYSKEYDOWN:
-            {
-                // wParam gives key code.
-                u32 KeyCode = (u32)Message.wParam;
-                #define KeyIsDownBitFlag (1 << 31)
-                #define KeyWasDownBitFlag (1 << 30)
-                bool IsDown  = (KeyIsDownBitFlag  & Message.lParam) == 0;
-                bool WasDown = (KeyWasDownBitFlag & Message.lParam) != 0;
-                Input->KeyState[KeyCode].IsDown = IsDown;
-                Input->OldKeyState[KeyCode].IsDown = WasDown;
+// NOTE: (Marcus) Receives, then works out whether this frame simulates a
+// tick and with what.  The simulation has to be the same on both sides so
+// the screen size and frame time are pinned.
+internal void
+Win32NetBeginFrame(win32_net_peer *Peer, u8 LocalButtons, app_input *Input)
+{
+    Win32NetReceive(Peer);
+    LockstepAdvance(&Peer->Session, LocalButtons, Input);
+    Input->ScreenWidth = NET_SCREEN_WIDTH;
+    Input->ScreenHeight = NET_SCREEN_HEIGHT;
+}
 
-                // char Text[256];
-                // wsprintf(Text, "Key %d IsDown %d WasDown %d \n", KeyCode, IsDown, WasDown);
-                // OutputDebugStringA(Text);
-            } break;
-        }
+internal void
+Win32NetEndFrame(win32_net_peer *Peer, app_memory *Memory, app_input *Input)
+{
+    if (!Input->Stalled)
+    {
+        LockstepRecordHash(&Peer->Session, NetHashState(Memory->PerminantStorage, sizeof(game_state)));
+    }
+    Win32NetSend(Peer);
+}
 
-        TranslateMessage(&Message);
-        DispatchMessage(&Message);
+// NOTE: (Marcus) -netloopback plays against a second copy of the game in
+// this process, over real sockets on 127.0.0.1.  It never gets drawn and
+// mashes random buttons, it is there to prove both sides stay in sync.
+#define WIN32_LOOPBACK_HOST_PORT 27960
+#define WIN32_LOOPBACK_GUEST_PORT 27961
+
+struct win32_loopback_game
+{
+    win32_net_peer Net;
+    app_memory Memory;
+    win32_memory_block PushBufferBlock;
+    u8 Buttons;
+};
+
+internal bool
+Win32StartLoopbackGame(win32_loopback_game *Game, u32 InputDelay, u32 LossPercent, u32 DelayMS)
+{
+    win32_memory_block PerminantBlock = Win32ReserveMemory(Gigabytes(1));
+    win32_memory_block TransientBlock = Win32ReserveMemory(Gigabytes(4));
+    Game->PushBufferBlock = Win32ReserveMemory(Megabytes(256));
+    if (!PerminantBlock.Base || !TransientBlock.Base || !Game->PushBufferBlock.Base)
+    {
+        return(false);
+    }
+    Game->Memory.PerminantStorageSize = PerminantBlock.Size;
+    Game->Memory.PerminantStorage = PerminantBlock.Base;
+    Game->Memory.TransientStorageSize = TransientBlock.Size;
+    Game->Memory.TransientStorage = TransientBlock.Base;
+    Game->Memory.CommitMemory = Win32CommitMemory;
+
+    Game->Net.LossPercent = LossPercent;
+    Game->Net.DelayMS = DelayMS;
+    bool Result = Win32OpenNetPeer(&Game->Net, WIN32_LOOPBACK_GUEST_PORT, 1, InputDelay);
+    if (Result)
+    {
+        char Address[32];
+        wsprintf(Address, "127.0.0.1:%d", WIN32_LOOPBACK_HOST_PORT);
+        Win32SetNetPeerAddress(&Game->Net, Address);
     }
+    return(Result);
 }
 
 internal void
-Win32BlitImageToScreen(HDC DeviceContext, int ScreenWidth, int ScreenHeight, win32_screen_buffer Buffer)
+Win32StepLoopbackGame(win32_loopback_game *Game)
 {
-    StretchDIBits(
-        DeviceContext,
-        0, 0, ScreenWidth, ScreenHeight,
-        0, 0, Buffer.Width, Buffer.Height,
-        Buffer.Buffer,
-        &Buffer.BitmapInfo,
-        DIB_RGB_COLORS,
-        SRCCOPY
-    );
+    // NOTE: Hold each random set of buttons for a third of a second.
+    if ((Game->Net.Session.Tick % 20) == 0)
+    {
+        Game->Buttons = (u8)(Win32NetRandom(&Game->Net) & ((1 << Button_BitCount) - 1));
+    }
+
+    app_input Input = {};
+    Win32NetBeginFrame(&Game->Net, Game->Buttons, &Input);
+
+    render_commands RenderCommands = CreateRenderCommands(
+        Game->PushBufferBlock.Size, Game->PushBufferBlock.Base,
+        Game->PushBufferBlock.Committed, Win32CommitMemory);
+    audio_commands AudioCommands = {};
+    GameUpdateAndRender(Input, &Game->Memory, &RenderCommands, &AudioCommands);
+    Game->PushBufferBlock.Committed = RenderCommands.PushBufferCommitted;
+
+    Win32NetEndFrame(&Game->Net, &Game->Memory, &Input);
 }
 
 LRESULT CALLBACK
@@ -299,18 +1501,144 @@ WinMain(HINSTANCE Instance,
             float DesiredSecsPerFrame = (1.0f / DesiredFPS);
             float DesiredMsPerFrame = (DesiredSecsPerFrame * 1000);
 
+            // NOTE: (Marcus) -hugepages trades the growable permanent storage
+            // and push buffer for fixed, pre-faulted ones, large page backed
+            // when the privilege can be enabled.
+            bool HotMemory = (strstr(CommandLine, "-hugepages") != 0);
+            bool LargePages = HotMemory && Win32EnableLargePages();
+
+            win32_memory_block PerminantBlock = HotMemory
+                ? Win32AllocateHotMemory(Megabytes(16), LargePages)
+                : Win32ReserveMemory(Gigabytes(1));
+            win32_memory_block TransientBlock = Win32ReserveMemory(Gigabytes(4));
+            win32_memory_block PushBufferBlock = HotMemory
+                ? Win32AllocateHotMemory(Megabytes(16), LargePages)
+                : Win32ReserveMemory(Megabytes(256));
+            win32_memory_block AudioBlock = Win32ReserveMemory(Megabytes(16));
+            if (!PerminantBlock.Base || !TransientBlock.Base ||
+                !PushBufferBlock.Base || !AudioBlock.Base)
+            {
+                OutputDebugStringA("Failed to reserve game memory\n");
+                return 0;
+            }
+
             app_memory Memory = {};
-            Memory.PerminantStorageSize = 1000000;
-            Memory.TransientStorageSize = 256000;
-            u64 TotalMemory = (Memory.PerminantStorageSize + Memory.TransientStorageSize);
-            Memory.PerminantStorage = Win32AllocateMemory(TotalMemory);
-            Memory.TransientStorage = ((u8 *)Memory.PerminantStorage + Memory.PerminantStorageSize);
-            
-            u64 PushBufferSize = 1000000;
-            void *PushBuffer = Win32AllocateMemory(PushBufferSize);
+            Memory.PerminantStorageSize = PerminantBlock.Size;
+            Memory.PerminantStorageCommitted = PerminantBlock.Committed;
+            Memory.PerminantStorage = PerminantBlock.Base;
+            Memory.TransientStorageSize = TransientBlock.Size;
+            Memory.TransientStorageCommitted = TransientBlock.Committed;
+            Memory.TransientStorage = TransientBlock.Base;
+            Memory.CommitMemory = Win32CommitMemory;
+
+            memory_arena AudioArena;
+            InitializeArena(&AudioArena, AudioBlock.Size, AudioBlock.Base,
+                            AudioBlock.Committed, Win32CommitMemory);
+            audio_mixer *Mixer = PushStruct(&AudioArena, audio_mixer);
+            InitializeMixer(Mixer, &AudioArena);
+
+            // NOTE: (Marcus) -wav <file> writes the mix to disk instead of
+            // playing it, for testing without a sound device.
+            win32_audio Audio = {};
+            Audio.Mixer = Mixer;
+            Audio.WriteWav = Win32GetArgument(CommandLine, "-wav", Audio.WavPath, sizeof(Audio.WavPath));
+            Win32StartAudio(&Audio);
+            audio_commands AudioCommands = {};
+
+            // NOTE: (Marcus) Lockstep co-op, see app_net.cpp.  -host <port>
+            // waits for a player to join, -join <ip:port> joins one.
+            // -netloopback plays against a headless copy of the game in this
+            // process.  -netloss <percent> and -netdelay <ms> make the link
+            // worse, -netinputdelay <ticks> trades latency for fewer stalls.
+            char Argument[64];
+            u32 InputDelay = 3;
+            u32 LossPercent = 0;
+            u32 DelayMS = 0;
+            if (Win32GetArgument(CommandLine, "-netinputdelay", Argument, sizeof(Argument)))
+                InputDelay = Win32ParseU32(Argument);
+            if (Win32GetArgument(CommandLine, "-netloss", Argument, sizeof(Argument)))
+                LossPercent = Win32ParseU32(Argument);
+            if (Win32GetArgument(CommandLine, "-netdelay", Argument, sizeof(Argument)))
+                DelayMS = Win32ParseU32(Argument);
+
+            win32_net_peer Net = {};
+            Net.Socket = INVALID_SOCKET;
+            Net.LossPercent = LossPercent;
+            Net.DelayMS = DelayMS;
+            win32_loopback_game Loopback = {};
+            Loopback.Net.Socket = INVALID_SOCKET;
+            bool Networked = false;
+            bool IsLoopback = (strstr(CommandLine, "-netloopback") != 0);
+            bool WantsNetwork = (IsLoopback || strstr(CommandLine, "-host") || strstr(CommandLine, "-join"));
+
+            WSADATA WinSockData;
+            bool WinSockStarted = (WantsNetwork && WSAStartup(MAKEWORD(2, 2), &WinSockData) == 0);
+            if (WinSockStarted)
+            {
+                if (IsLoopback)
+                {
+                    char Address[32];
+                    wsprintf(Address, "127.0.0.1:%d", WIN32_LOOPBACK_GUEST_PORT);
+                    Networked = (Win32OpenNetPeer(&Net, WIN32_LOOPBACK_HOST_PORT, 0, InputDelay) &&
+                                 Win32StartLoopbackGame(&Loopback, InputDelay, LossPercent, DelayMS));
+                    Win32SetNetPeerAddress(&Net, Address);
+                }
+                else if (Win32GetArgument(CommandLine, "-host", Argument, sizeof(Argument)))
+                {
+                    Networked = Win32OpenNetPeer(&Net, Win32ParseU32(Argument), 0, InputDelay);
+                }
+                else if (Win32GetArgument(CommandLine, "-join", Argument, sizeof(Argument)))
+                {
+                    Networked = Win32OpenNetPeer(&Net, 0, 1, InputDelay);
+                    Win32SetNetPeerAddress(&Net, Argument);
+                }
+            }
+
+            if (Networked)
+            {
+                Win32ResizeScreenBuffer(NET_SCREEN_WIDTH, NET_SCREEN_HEIGHT);
+                GlobalBackBuffer.SizeIsLocked = true;
+            }
+            else if (WantsNetwork)
+            {
+                OutputDebugStringA("Failed to start networking, playing alone\n");
+            }
+
+            // NOTE: (Marcus) -capture <file> streams every presented frame
+            // to disk, see Win32CaptureFrame.
+            win32_capture Capture = {};
+            if (Win32GetArgument(CommandLine, "-capture", Capture.Path, sizeof(Capture.Path)))
+            {
+                Win32StartCapture(&Capture, (u32)DesiredFPS);
+            }
+
+            // NOTE: (Marcus) The frame governor sheds quality when frames
+            // keep running over budget, see app_governor.cpp.  Collision is
+            // never thinned when networked, the other side has to run the
+            // same simulation, and resolution stays put while capturing.
+            // -nogovernor turns it off.
+            frame_governor Governor;
+            InitializeGovernor(&Governor, DesiredSecsPerFrame);
+            Governor.AllowSlowCollision = !Networked;
+            bool UseGovernor = (strstr(CommandLine, "-nogovernor") == 0);
+
+            // NOTE: Stage timings are in cycles, the rate is calibrated
+            // against the wall clock since startup.
+            LARGE_INTEGER CalibrationStart = Win32GetWallClock();
+            u64 CalibrationCycles = __rdtsc();
+
+            // NOTE: (Marcus) Counters are always published, -csv <file>
+            // also logs them.
+            char CsvPath[MAX_PATH];
+            bool WantsCsv = Win32GetArgument(CommandLine, "-csv", CsvPath, sizeof(CsvPath));
+            win32_counters Counters = {};
+            Win32StartCounters(&Counters, WantsCsv ? CsvPath : 0);
+            u64 FrameIndex = 0;
 
             app_input Input = {};
-            LARGE_INTEGER LastCounter = {};
+            win32_input_queue InputQueue = {};
+            LARGE_INTEGER LastPoll = Win32GetWallClock();
+            u32 InputLatencyUS = 0;
             float SecondsEllapsedForFrame = DesiredSecsPerFrame;
             GlobalWindowRunning = true;
             while (GlobalWindowRunning)
@@ -323,23 +1651,87 @@ WinMain(HINSTANCE Instance,
                 Input.ScreenWidth = Dim.Width;
                 Input.ScreenHeight = Dim.Height;
                 Input.FrameEllapsedSecs = SecondsEllapsedForFrame;
-                render_commands RenderCommands = CreateRenderCommands(PushBufferSize, PushBuffer);
+                render_commands RenderCommands = CreateRenderCommands(
+                    PushBufferBlock.Size, PushBufferBlock.Base,
+                    PushBufferBlock.Committed, Win32CommitMemory);
 
-                Win32PollWindowInput(&Input);
-                GameUpdateAndRender(Input, &Memory, &RenderCommands);
-                RenderSomething(&RenderCommands);
+                Win32PollWindowInput(&Input, &InputQueue, LastPoll);
+                LastPoll = Win32GetWallClock();
+                Input.Quality = GovernorQuality(&Governor);
+                if (Networked)
+                {
+                    Win32NetBeginFrame(&Net, NetButtonsFromKeyboard(&Input), &Input);
+                }
+                GameUpdateAndRender(Input, &Memory, &RenderCommands, &AudioCommands);
+                if (Networked)
+                {
+                    Win32NetEndFrame(&Net, &Memory, &Input);
+                    if (IsLoopback)
+                    {
+                        Win32StepLoopbackGame(&Loopback);
+                    }
+                }
+                MixerSubmit(Mixer, &AudioCommands);
+                u64 RasterStart = __rdtsc();
+                u64 PixelsFilled = RenderSomething(&RenderCommands);
+                u64 RasterCycles = __rdtsc() - RasterStart;
+                PushBufferBlock.Committed = RenderCommands.PushBufferCommitted;
 
+                // NOTE: The blit is left out of raster time, it is spent in
+                // the driver and the governor sheds by what the rasterizer
+                // costs.
                 Win32BlitImageToScreen(DeviceContext, Dim.Width, Dim.Height, GlobalBackBuffer);
                 ReleaseDC(WindowHandle, DeviceContext);
 
+                // NOTE: (Marcus) Key press to the shot it fired being on
+                // screen, only measured for shots fired on the press itself.
+                if (Memory.Stats.FireEventTimestamp)
+                {
+                    LARGE_INTEGER Presented = Win32GetWallClock();
+                    InputLatencyUS = (u32)(((Presented.QuadPart - (int64_t)Memory.Stats.FireEventTimestamp) * 1000000) /
+                                           GlobalPerformanceFrequency);
+                }
+
+                if (Capture.Active)
+                {
+                    Win32CaptureFrame(&Capture);
+                }
+
                 WorkCounterEnd = Win32GetWallClock();
                 SecondsEllapsedForFrame = Win32GetSecondsEllapsed(WorkCounterStart, WorkCounterEnd);
+                if (UseGovernor)
+                {
+                    float CalibrationSecs = Win32GetSecondsEllapsed(CalibrationStart, WorkCounterEnd);
+                    float SecsPerCycle = CalibrationSecs / (float)(__rdtsc() - CalibrationCycles);
+
+                    governor_frame Frame = {};
+                    Frame.TotalSecs = SecondsEllapsedForFrame;
+                    Frame.UpdateSecs = SecsPerCycle * (float)Memory.Stats.UpdateCycles;
+                    Frame.CollisionSecs = SecsPerCycle * (float)Memory.Stats.CollisionCycles;
+                    Frame.RasterSecs = SecsPerCycle * (float)RasterCycles;
+                    Governor.AllowHalfResolution = !Capture.Active;
+                    if (UpdateGovernor(&Governor, &Frame))
+                    {
+                        OutputDebugStringA(Governor.Log);
+                    }
+                    GlobalBackBuffer.ResolutionShift = GovernorResolutionShift(&Governor);
+                }
+
+                app_counters *FrameCounters = &Memory.Stats.Counters;
+                FrameCounters->FrameIndex = FrameIndex++;
+                FrameCounters->WorkMicroseconds = (u64)(SecondsEllapsedForFrame * 1000000.0f);
+                FrameCounters->PixelsFilled = PixelsFilled;
+                Win32PublishCounters(&Counters, FrameCounters);
+
                 if (SecondsEllapsedForFrame < DesiredSecsPerFrame)
                 {
                     while (SecondsEllapsedForFrame < DesiredSecsPerFrame)
                     {
+                        // NOTE: Wakes early for input so it is timestamped
+                        // when it arrives, not at the next poll.
                         DWORD SleepMS = 1000.0f * (DesiredSecsPerFrame - SecondsEllapsedForFrame);
-                        Sleep(SleepMS);
+                        MsgWaitForMultipleObjects(0, 0, FALSE, SleepMS, QS_ALLINPUT);
+                        Win32PumpMessages(&InputQueue);
 
                         SecondsEllapsedForFrame = Win32GetSecondsEllapsed(WorkCounterStart, Win32GetWallClock());
                     }
@@ -351,10 +1743,51 @@ WinMain(HINSTANCE Instance,
                 int32_t MSPerFrame = (int32_t)(1000*CounterEllapsed)/CounterFrequency;
                 int32_t FPS = CounterFrequency / CounterEllapsed;
 
-                char Text[256];
-                wsprintf(Text, "%s - FPS: %d  MS: %d", APP_NAME, FPS, MSPerFrame);
+                app_frame_stats *Stats = &Memory.Stats;
+                char Text[512];
+                wsprintf(Text, "%s - FPS: %d  MS: %d  Rewind: %d frames %dKB snap %d cy restore %d cy"
+                         "  Audio: %d ms underruns %d  Input: %d us",
+                         APP_NAME, FPS, MSPerFrame,
+                         Stats->RewindFrameCount, (u32)(Stats->RewindBytesInUse / 1024),
+                         (u32)Stats->RewindSnapshotCycles, (u32)Stats->RewindRestoreCycles,
+                         (Mixer->LatencyFrames * 1000) / MIXER_SAMPLES_PER_SECOND,
+                         Mixer->UnderrunFrames, InputLatencyUS);
+                if (Networked)
+                {
+                    lockstep_session *Session = &Net.Session;
+                    u32 Frames = Session->Tick + Session->StalledFrames;
+                    u32 BytesPerSec = (u32)((Session->BytesSent * 60) / (Frames ? Frames : 1));
+                    wsprintf(Text + strlen(Text), "  Net: %s %d stalls %d desyncs %d %d B/s",
+                             Session->HeardFromRemote ? "tick" : "waiting, tick", Session->Tick,
+                             Session->StalledFrames, Session->Desyncs + Loopback.Net.Session.Desyncs,
+                             BytesPerSec);
+                }
+                if (Capture.Active)
+                {
+                    wsprintf(Text + strlen(Text), "  Capture: %d frames %d dropped %d us",
+                             Capture.FramesWritten, Capture.FramesDropped,
+                             (u32)(Capture.SubmitSecs * 1000000.0f));
+                }
+                if (Governor.StepCount)
+                {
+                    wsprintf(Text + strlen(Text), "  Governor: %d steps shed", Governor.StepCount);
+                }
                 SetWindowTextA(WindowHandle, Text);
             }
+
+            if (Capture.Active)
+            {
+                Win32StopCapture(&Capture);
+            }
+            Win32StopCounters(&Counters);
+
+            if (WinSockStarted)
+            {
+                Win32CloseNetPeer(&Net);
+                Win32CloseNetPeer(&Loopback.Net);
+                WSACleanup();
+            }
+            Win32StopAudio(&Audio);
         }
     }
 
@@ -0,0 +1,178 @@
+#include <Windows.h>
+
+#include "app.cpp"
+#include "app_batch.cpp"
+
+// NOTE: (Marcus) Headless batch simulation built as a DLL, no window and
+// no sound.  Exports:
+//
+//   NsiBatchCreate(InstanceCount, ScreenWidth, ScreenHeight,
+//                  ObservationWidth, ObservationHeight, ThreadCount)
+//   NsiBatchStep(Batch, Actions, Rewards, Outcomes, Observations)
+//   NsiBatchGetStates(Batch)
+//   NsiBatchDestroy(Batch)
+//
+// See BatchStep in app_batch.cpp for the array layouts.
+
+struct platform_work_queue_entry
+{
+    platform_work_queue_callback *Callback;
+    void *Data;
+};
+
+struct platform_work_queue
+{
+    u32 volatile CompletionGoal;
+    u32 volatile CompletionCount;
+
+    u32 volatile NextEntryToWrite;
+    u32 volatile NextEntryToRead;
+    HANDLE SemaphoreHandle;
+
+    bool volatile Quit;
+    u32 ThreadCount;
+    HANDLE Threads[64];
+
+    platform_work_queue_entry Entries[4096];
+};
+
+internal void
+Win32AddEntry(platform_work_queue *Queue, platform_work_queue_callback *Callback, void *Data)
+{
+    u32 NewNextEntryToWrite = (Queue->NextEntryToWrite + 1) % ArraySize(Queue->Entries);
+    Assert(NewNextEntryToWrite != Queue->NextEntryToRead);
+    platform_work_queue_entry *Entry = Queue->Entries + Queue->NextEntryToWrite;
+    Entry->Callback = Callback;
+    Entry->Data = Data;
+    ++Queue->CompletionGoal;
+
+    CompletePreviousWritesBeforeFutureWrites;
+    Queue->NextEntryToWrite = NewNextEntryToWrite;
+    ReleaseSemaphore(Queue->SemaphoreHandle, 1, 0);
+}
+
+// NOTE: Returns true when there was nothing to do.
+internal bool
+Win32DoNextWorkQueueEntry(platform_work_queue *Queue)
+{
+    bool WeShouldSleep = false;
+
+    u32 OriginalNextEntryToRead = Queue->NextEntryToRead;
+    u32 NewNextEntryToRead = (OriginalNextEntryToRead + 1) % ArraySize(Queue->Entries);
+    if (OriginalNextEntryToRead != Queue->NextEntryToWrite)
+    {
+        u32 Index = InterlockedCompareExchange((LONG volatile *)&Queue->NextEntryToRead,
+                                               NewNextEntryToRead,
+                                               OriginalNextEntryToRead);
+        if (Index == OriginalNextEntryToRead)
+        {
+            platform_work_queue_entry Entry = Queue->Entries[Index];
+            Entry.Callback(Queue, Entry.Data);
+            InterlockedIncrement((LONG volatile *)&Queue->CompletionCount);
+        }
+    }
+    else
+    {
+        WeShouldSleep = true;
+    }
+
+    return(WeShouldSleep);
+}
+
+internal void
+Win32CompleteAllWork(platform_work_queue *Queue)
+{
+    while (Queue->CompletionGoal != Queue->CompletionCount)
+    {
+        Win32DoNextWorkQueueEntry(Queue);
+    }
+
+    Queue->CompletionGoal = 0;
+    Queue->CompletionCount = 0;
+}
+
+DWORD WINAPI
+Win32WorkerThread(LPVOID Parameter)
+{
+    platform_work_queue *Queue = (platform_work_queue *)Parameter;
+    while (!Queue->Quit)
+    {
+        if (Win32DoNextWorkQueueEntry(Queue))
+        {
+            WaitForSingleObject(Queue->SemaphoreHandle, INFINITE);
+        }
+    }
+    return(0);
+}
+
+internal void
+Win32MakeQueue(platform_work_queue *Queue, u32 ThreadCount)
+{
+    Queue->ThreadCount = (ThreadCount < ArraySize(Queue->Threads)) ? ThreadCount : ArraySize(Queue->Threads);
+    Queue->SemaphoreHandle = CreateSemaphoreA(0, 0, ArraySize(Queue->Entries), 0);
+    for (u32 Index = 0; Index < Queue->ThreadCount; ++Index)
+    {
+        Queue->Threads[Index] = CreateThread(0, 0, Win32WorkerThread, Queue, 0, 0);
+    }
+}
+
+internal void
+Win32DestroyQueue(platform_work_queue *Queue)
+{
+    Queue->Quit = true;
+    ReleaseSemaphore(Queue->SemaphoreHandle, Queue->ThreadCount, 0);
+    for (u32 Index = 0; Index < Queue->ThreadCount; ++Index)
+    {
+        WaitForSingleObject(Queue->Threads[Index], INFINITE);
+        CloseHandle(Queue->Threads[Index]);
+    }
+    CloseHandle(Queue->SemaphoreHandle);
+}
+
+// NOTE: (Marcus) The queue sits in the same block right after the batch
+// memory.  ThreadCount 0 means one worker per logical processor minus the
+// calling thread, which helps out in CompleteAllWork.
+extern "C" __declspec(dllexport) batch_sim *
+NsiBatchCreate(u32 InstanceCount, u32 ScreenWidth, u32 ScreenHeight,
+               u32 ObservationWidth, u32 ObservationHeight, u32 ThreadCount)
+{
+    if (ThreadCount == 0)
+    {
+        SYSTEM_INFO SystemInfo;
+        GetSystemInfo(&SystemInfo);
+        ThreadCount = (SystemInfo.dwNumberOfProcessors > 1) ? SystemInfo.dwNumberOfProcessors - 1 : 1;
+    }
+
+    umi BatchSize = AlignPow2(BatchMemorySize(InstanceCount), 64);
+    umi TotalSize = BatchSize + sizeof(platform_work_queue);
+    void *Memory = VirtualAlloc(0, TotalSize, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+    if (!Memory) return(0);
+
+    batch_sim *Batch = BatchInitialize(Memory, InstanceCount, ScreenWidth, ScreenHeight,
+                                       ObservationWidth, ObservationHeight);
+    Batch->Queue = (platform_work_queue *)((u8 *)Memory + BatchSize);
+    Batch->AddEntry = Win32AddEntry;
+    Batch->CompleteAllWork = Win32CompleteAllWork;
+    Win32MakeQueue(Batch->Queue, ThreadCount);
+
+    return(Batch);
+}
+
+extern "C" __declspec(dllexport) void
+NsiBatchStep(batch_sim *Batch, app_input *Actions, float *Rewards, u32 *Outcomes, u8 *Observations)
+{
+    BatchStep(Batch, Actions, Rewards, Outcomes, Observations);
+}
+
+extern "C" __declspec(dllexport) game_state *
+NsiBatchGetStates(batch_sim *Batch)
+{
+    return(Batch->States);
+}
+
+extern "C" __declspec(dllexport) void
+NsiBatchDestroy(batch_sim *Batch)
+{
+    Win32DestroyQueue(Batch->Queue);
+    VirtualFree(Batch, 0, MEM_RELEASE);
+}
@@ -0,0 +1,91 @@
+#include <Windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "app.h"
+
+// NOTE: (Marcus) Console tool that samples the counters a running
+// win32_nsi.exe publishes, see app_counters_block.  Prints every counter
+// once per interval, -interval <ms> (default 1000).  -pid <n> picks which
+// game to watch, otherwise it is whichever game window FindWindow finds.
+// It only ever reads the block, the game never waits on it.
+
+int
+main(int ArgCount, char **Args)
+{
+    DWORD IntervalMS = 1000;
+    DWORD ProcessID = 0;
+    for (int ArgIndex = 1; ArgIndex < (ArgCount - 1); ++ArgIndex)
+    {
+        if (strcmp(Args[ArgIndex], "-interval") == 0)
+        {
+            IntervalMS = (DWORD)atoi(Args[ArgIndex + 1]);
+        }
+        if (strcmp(Args[ArgIndex], "-pid") == 0)
+        {
+            ProcessID = (DWORD)atoi(Args[ArgIndex + 1]);
+        }
+    }
+
+    app_counters_block *Block = 0;
+    while (!Block)
+    {
+        // NOTE: The window class win32_nsi.cpp registers.
+        DWORD GameID = ProcessID;
+        HWND Window = GameID ? 0 : FindWindowA("NsiWindowClass", 0);
+        if (Window)
+        {
+            GetWindowThreadProcessId(Window, &GameID);
+        }
+
+        char Name[64];
+        sprintf(Name, APP_COUNTERS_SHARED_NAME, (u32)GameID);
+        HANDLE Mapping = GameID ? OpenFileMappingA(FILE_MAP_READ, FALSE, Name) : 0;
+        if (Mapping)
+        {
+            Block = (app_counters_block *)MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0,
+                                                        sizeof(app_counters_block));
+        }
+        if (!Block)
+        {
+            printf("Waiting for %s...\n", APP_NAME);
+            Sleep(IntervalMS);
+        }
+    }
+
+    if (Block->Version != APP_COUNTERS_VERSION || Block->Size != sizeof(app_counters))
+    {
+        printf("Counters version %u size %u, expected version %u size %u\n",
+               Block->Version, Block->Size, APP_COUNTERS_VERSION, (u32)sizeof(app_counters));
+        return(1);
+    }
+
+    // NOTE: The first sample only says where the game was, there is no
+    // earlier one to count frames from.
+    bool HaveLast = false;
+    u64 LastFrameIndex = 0;
+    for (;;)
+    {
+        app_counters Counters;
+        if (SampleCounters(Block, &Counters))
+        {
+            if (HaveLast)
+            {
+                printf("-- %llu frames since last sample\n", Counters.FrameIndex - LastFrameIndex);
+            }
+            else
+            {
+                printf("-- first sample\n");
+            }
+            HaveLast = true;
+            LastFrameIndex = Counters.FrameIndex;
+
+            u64 *Values = (u64 *)&Counters;
+            for (u32 Index = 0; Index < APP_COUNTER_COUNT; ++Index)
+            {
+                printf("%-24s %llu\n", AppCounterNames[Index], Values[Index]);
+            }
+        }
+        Sleep(IntervalMS);
+    }
+}